@@ -7,8 +7,9 @@ class ALU {
     private:
         int ALU_control_inputs;
     public:
-        // Generate the control inputs for the ALU
-        void generate_control_inputs(int ALU_op, int funct, int opcode) {
+        // Generate the control inputs for the ALU. Returns false for an R-type funct or an
+        // I-type opcode it does not know, which is then executed as an add.
+        bool generate_control_inputs(int ALU_op, int funct, int opcode) {
             if(!ALU_op) { // loads, stores
                 ALU_control_inputs = 2; // set to add
             } 
@@ -19,14 +20,21 @@ class ALU {
                 switch(funct) {
                     case 0x00: ALU_control_inputs = 3; break;               // sll
                     case 0x02: ALU_control_inputs = 4; break;               // srl
+                    case 0x03: ALU_control_inputs = 8; break;               // sra
+                    case 0x04: ALU_control_inputs = 3; break;               // sllv
+                    case 0x06: ALU_control_inputs = 4; break;               // srlv
+                    case 0x07: ALU_control_inputs = 8; break;               // srav
                     case 0x08: ALU_control_inputs = 2; break;               // don't care
+                    case 0x10: case 0x11: case 0x12: case 0x13:             // HI/LO unit, don't care
+                    case 0x18: case 0x19: case 0x1a: case 0x1b: ALU_control_inputs = 2; break;
                     case 0x20: case 0x21: ALU_control_inputs = 2; break;    // add
                     case 0x22: case 0x23: ALU_control_inputs = 6; break;    // sub
                     case 0x24: ALU_control_inputs = 0; break;               // and
                     case 0x25: ALU_control_inputs = 1; break;               // or
+                    case 0x26: ALU_control_inputs = 13; break;              // xor
                     case 0x27: ALU_control_inputs = 12; break;              // nor
                     case 0x2a: case 0x2b: ALU_control_inputs = 7; break;    // slt
-                    default: ALU_control_inputs = 2;
+                    default: ALU_control_inputs = 2; return false;
                 }
             }
             else { // Other I-type
@@ -35,10 +43,12 @@ class ALU {
                     case 0xa: case 0xb: ALU_control_inputs = 7; break;      // slt
                     case 0xc: ALU_control_inputs = 0; break;                // and
                     case 0xd: ALU_control_inputs = 1; break;                // or
+                    case 0xe: ALU_control_inputs = 13; break;               // xor
                     case 0xf: ALU_control_inputs = 5; break;                // lui
-                    default: ALU_control_inputs = 2;
+                    default: ALU_control_inputs = 2; return false;
                 }
             }
+            return true;
         }
         
         // execute ALU operations, generate result, and set the zero control signal if necessary
@@ -48,12 +58,14 @@ class ALU {
                 case 0: result = operand_1 & operand_2; break;
                 case 1: result = operand_1 | operand_2; break;
                 case 2: result = operand_1 + operand_2; break;
-                case 3: result = operand_2 << operand_1; break;
-                case 4: result = operand_2 >> operand_1; break;
+                case 3: result = operand_2 << (operand_1 & 0x1f); break;
+                case 4: result = operand_2 >> (operand_1 & 0x1f); break;
                 case 5: result = operand_2 << 16; break;
                 case 6: result = operand_1 - operand_2; break;
                 case 7: result = ((int)operand_1 < (int)operand_2) ? 1 : 0; break;
+                case 8: result = (int32_t)operand_2 >> (operand_1 & 0x1f); break;
                 case 12: result = ~(operand_1 | operand_2); break;
+                case 13: result = operand_1 ^ operand_2; break;
                 default: result = operand_1 + operand_2; break;
             }
             if(!result) {
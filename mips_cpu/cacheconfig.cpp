@@ -0,0 +1,166 @@
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include "cacheconfig.h"
+
+using namespace std;
+
+vector<CacheConfig> defaultHierarchy() {
+    vector<CacheConfig> levels;
+    levels.push_back({"L1", 32768, 8, 64, 12, true, true, INCLUSIVE, true});
+    levels.push_back({"L2", 262144, 8, 64, 59, true, true, INCLUSIVE, false});
+    return levels;
+}
+
+static bool powerOfTwo(int n) {
+    return n > 0 && (n & (n-1)) == 0;
+}
+
+// Parses a byte count with an optional K or M suffix
+static bool parseSize(const string &value, int &bytes) {
+    char *end;
+    long n = strtol(value.c_str(), &end, 10);
+    if (end == value.c_str()) {
+        return false;
+    }
+    string suffix(end);
+    if (suffix == "K" || suffix == "k" || suffix == "KB" || suffix == "kB") {
+        n <<= 10;
+    } else if (suffix == "M" || suffix == "m" || suffix == "MB") {
+        n <<= 20;
+    } else if (!suffix.empty()) {
+        return false;
+    }
+    bytes = n;
+    return n > 0;
+}
+
+bool applyCacheSpec(vector<CacheConfig> &levels, const string &spec, string &error) {
+    string fields = spec;
+    for (char &ch : fields) {
+        if (ch == ',') {
+            ch = ' ';
+        }
+    }
+    istringstream in(fields);
+    string name;
+    if (!(in >> name) || name.find('=') != string::npos) {
+        error = "cache spec \"" + spec + "\" does not start with a level name";
+        return false;
+    }
+
+    CacheConfig *level = NULL;
+    for (CacheConfig &l : levels) {
+        if (l.name == name) {
+            level = &l;
+        }
+    }
+    if (!level) {
+        // a new first level is split unless told otherwise, like the default one
+        levels.push_back({name, 0, 8, 64, 0, true, true, INCLUSIVE, levels.empty()});
+        level = &levels.back();
+    }
+
+    string field;
+    while (in >> field) {
+        size_t eq = field.find('=');
+        string key = field.substr(0, eq);
+        string value = (eq == string::npos) ? "" : field.substr(eq+1);
+        bool ok = true;
+        if (key == "size") {
+            ok = parseSize(value, level->size);
+        } else if (key == "assoc") {
+            level->assoc = atoi(value.c_str());
+        } else if (key == "line") {
+            ok = parseSize(value, level->lineSize);
+        } else if (key == "penalty") {
+            level->penalty = atoi(value.c_str());
+        } else if (key == "write") {
+            ok = (value == "back" || value == "through");
+            level->writeBack = (value == "back");
+        } else if (key == "allocate") {
+            ok = (value == "yes" || value == "no");
+            level->writeAllocate = (value == "yes");
+        } else if (key == "inclusion") {
+            ok = (value == "inclusive" || value == "exclusive" || value == "nine");
+            level->inclusion = (value == "exclusive") ? EXCLUSIVE : (value == "nine") ? NINE : INCLUSIVE;
+        } else if (key == "split") {
+            ok = (value == "yes" || value == "no");
+            level->split = (value == "yes");
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            error = "bad field \"" + field + "\" for cache " + name;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool loadCacheConfig(vector<CacheConfig> &levels, const string &path, string &error) {
+    ifstream file(path);
+    if (!file) {
+        error = "cannot open cache config " + path;
+        return false;
+    }
+    levels.clear();
+    string line;
+    while (getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        if (line.find_first_not_of(" \t\r") == string::npos) {
+            continue;
+        }
+        if (!applyCacheSpec(levels, line, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkHierarchy(const vector<CacheConfig> &levels, string &error) {
+    if (levels.empty()) {
+        error = "the hierarchy needs at least one cache";
+        return false;
+    }
+    for (int i = 0; i < (int)levels.size(); i++) {
+        const CacheConfig &l = levels[i];
+        if (!powerOfTwo(l.size) || !powerOfTwo(l.assoc) || !powerOfTwo(l.lineSize) || l.lineSize < 4 ||
+            l.size < l.assoc*l.lineSize) {
+            error = l.name + ": size, assoc and line must be powers of two with size >= assoc*line >= 4";
+            return false;
+        }
+        if (l.penalty < 1) {
+            error = l.name + ": penalty must be at least one cycle";
+            return false;
+        }
+        if (i > 0 && l.lineSize < levels[i-1].lineSize) {
+            error = l.name + ": line size is smaller than " + levels[i-1].name + "'s";
+            return false;
+        }
+        if (i > 0 && l.split) {
+            error = l.name + ": only the first level can be split into instruction and data caches";
+            return false;
+        }
+        if (i > 0 && l.inclusion == EXCLUSIVE && l.lineSize != levels[i-1].lineSize) {
+            error = l.name + ": an exclusive level needs the same line size as " + levels[i-1].name;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool buildHierarchy(const string &path, const vector<string> &specs, vector<CacheConfig> &levels, string &error) {
+    levels = defaultHierarchy();
+    if (!path.empty() && !loadCacheConfig(levels, path, error)) {
+        return false;
+    }
+    for (const string &spec : specs) {
+        if (!applyCacheSpec(levels, spec, error)) {
+            return false;
+        }
+    }
+    return checkHierarchy(levels, error);
+}
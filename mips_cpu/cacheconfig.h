@@ -0,0 +1,49 @@
+#ifndef CACHECONFIG
+#define CACHECONFIG
+#include <vector>
+#include <string>
+
+// How a shared level relates to the contents of the levels above it
+enum Inclusion {
+    INCLUSIVE,      // holds everything above it; evicting a line removes it above too
+    EXCLUSIVE,      // holds only what is not above it: fills move lines up, victims from above land here
+    NINE            // neither: filled on misses, evicts without touching the levels above
+};
+
+// One level of the hierarchy. The first level is private to every core, the others are shared.
+struct CacheConfig {
+    std::string name;
+    int size;               // bytes
+    int assoc;
+    int lineSize;           // bytes
+    int penalty;            // cycles to get a line from further out when this level misses
+    bool writeBack;         // false: write-through
+    bool writeAllocate;     // false: write misses bypass this level
+    Inclusion inclusion;    // ignored for the first level
+    bool split;             // first level only: separate instruction and data caches of this geometry
+};
+
+// 32KB 8-way L1I and L1D per core and a 256KB 8-way shared L2, 64B lines, write-back
+// and write-allocate, with an inclusive L2
+std::vector<CacheConfig> defaultHierarchy();
+
+// Applies one level spec, "name,key=value,..." with keys size (K/M suffixes allowed), assoc,
+// line, penalty, write=back|through, allocate=yes|no, inclusion=inclusive|exclusive|nine,
+// split=yes|no. Changes the level with that name, or adds it as the new outermost level.
+bool applyCacheSpec(std::vector<CacheConfig> &levels, const std::string &spec, std::string &error);
+
+// Replaces the hierarchy with the one in a file: one level spec per line, innermost first,
+// commas or blanks between fields, '#' starts a comment
+bool loadCacheConfig(std::vector<CacheConfig> &levels, const std::string &path, std::string &error);
+
+// The default hierarchy, or the one in path if not empty, changed by each spec in turn and
+// checked; returns false with the reason in error otherwise
+bool buildHierarchy(const std::string &path, const std::vector<std::string> &specs,
+                    std::vector<CacheConfig> &levels, std::string &error);
+
+// Checks that the hierarchy can be simulated: power-of-two geometry, line sizes that never
+// shrink going outward, exclusive levels with the same line size as the level above, and
+// only the first level split
+bool checkHierarchy(const std::vector<CacheConfig> &levels, std::string &error);
+
+#endif
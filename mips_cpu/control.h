@@ -11,7 +11,7 @@ struct control_t {
     bool jump;               // 1 if jummp
     bool jump_reg;           // 1 if jr
     bool link;               // 1 if jal
-    bool shift;              // 1 if sll or srl
+    bool shift;              // 1 if sll, srl or sra
     bool branch;             // 1 if branch
     bool bne;                // 1 if bne
     bool mem_read;           // 1 if memory needs to be read
@@ -23,17 +23,19 @@ struct control_t {
     bool ALU_src;            // 0 if second operand is from reg_file, 1 if imm
     bool reg_write;          // 1 if need to write back to reg file
     bool zero_extend;        // 1 if immediate needs to be zero-extended
+    bool linked;             // 1 if ll or sc
+    bool mult_div;           // 1 if mult, multu, div, divu, mfhi, mflo, mthi or mtlo
     
-    void print() {      // Prints the generated contol signals
-        cout << "REG_DEST: " << reg_dest << "\n";
-        cout << "JUMP: " << jump << "\n";
-        cout << "BRANCH: " << branch << "\n";
-        cout << "MEM_READ: " << mem_read << "\n";
-        cout << "MEM_TO_REG: " << mem_to_reg << "\n";
-        cout << "ALU_OP: " << ALU_op << "\n";
-        cout << "MEM_WRITE: " << mem_write << "\n";
-        cout << "ALU_SRC: " << ALU_src << "\n";
-        cout << "REG_WRITE: " << reg_write << "\n";
+    void print(ostream &out = cout) {      // Prints the generated contol signals
+        out << "REG_DEST: " << reg_dest << "\n";
+        out << "JUMP: " << jump << "\n";
+        out << "BRANCH: " << branch << "\n";
+        out << "MEM_READ: " << mem_read << "\n";
+        out << "MEM_TO_REG: " << mem_to_reg << "\n";
+        out << "ALU_OP: " << ALU_op << "\n";
+        out << "MEM_WRITE: " << mem_write << "\n";
+        out << "ALU_SRC: " << ALU_src << "\n";
+        out << "REG_WRITE: " << reg_write << "\n";
     }
     void reset() {
         reg_dest = 0;         
@@ -52,7 +54,8 @@ struct control_t {
         ALU_src = 0;           
         reg_write = 0;          
         zero_extend = 0;        
-
+        linked = 0;
+        mult_div = 0;
     }
     // Decode instructions into control signals
     void decode(uint32_t instruction) {
@@ -75,9 +78,19 @@ struct control_t {
             }
 
             // Special Case: shift
-            if ((instruction & 0x3f) == 0x0 || (instruction & 0x3f) == 0x2) {
+            if ((instruction & 0x3f) == 0x0 || (instruction & 0x3f) == 0x2 || (instruction & 0x3f) == 0x3) {
                 shift = 1;
             }
+
+            // Special Case: HI/LO instructions (functs 0x10-0x13 and 0x18-0x1b), only mfhi and
+            // mflo write a register
+            if ((instruction & 0x3c) == 0x10 || (instruction & 0x3c) == 0x18) {
+                mult_div = 1;
+                if ((instruction & 0x3f) != 0x10 && (instruction & 0x3f) != 0x12) {
+                    reg_dest = 0;
+                    reg_write = 0;
+                }
+            }
         } // end R-Type
         
         else if (opcode == 0x2 || opcode == 0x3) { // J-Type Instructions
@@ -104,9 +117,16 @@ struct control_t {
                 }
             } // end beq, bne
             
-            else if (opcode == 0x2b || opcode == 0x28 || opcode == 0x29) { // Stores
+            else if (opcode == 0x2b || opcode == 0x28 || opcode == 0x29 || opcode == 0x38) { // Stores
                 mem_write = 1;
 
+                // Special Case: sc writes its success flag back to rt
+                if (opcode == 0x38) {
+                    linked = 1;
+                    mem_to_reg = 1;
+                    reg_write = 1;
+                }
+
                 // Special Case: sb, sh
                 if (opcode == 0x28) { // sb
                     byte = 1;
@@ -128,13 +148,16 @@ struct control_t {
                 else if (opcode == 0x25) { // lhu
                     halfword = 1;
                 }
+                else if (opcode == 0x30) { // ll
+                    linked = 1;
+                }
             } // end loads
 
             else { // Catch all I-type Instrcutions
                 reg_write = 1;
                 ALU_op = 3; 
-                // Special Case: ori, andi
-                if (opcode == 0xc || opcode == 0xd) {
+                // Special Case: ori, andi, xori
+                if (opcode == 0xc || opcode == 0xd || opcode == 0xe) {
                     zero_extend = 1;
                 }
             }
@@ -0,0 +1,216 @@
+#include <vector>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <algorithm>
+#include "dram.h"
+
+#ifdef ENABLE_DEBUG
+#define DEBUG(x) x
+#else
+#define DEBUG(x)
+#endif
+
+using namespace std;
+
+DRAMConfig defaultDRAM() {
+    return {1, 8, 2048, 14, 14, 14, 4, 16, true};
+}
+
+bool applyDRAMSpec(DRAMConfig &config, const string &spec, string &error) {
+    string fields = spec;
+    for (char &ch : fields) {
+        if (ch == ',') {
+            ch = ' ';
+        }
+    }
+    istringstream in(fields);
+    string field;
+    while (in >> field) {
+        size_t eq = field.find('=');
+        string key = field.substr(0, eq);
+        string value = (eq == string::npos) ? "" : field.substr(eq+1);
+        char *end;
+        long n = strtol(value.c_str(), &end, 10);
+        string suffix(end);
+        if (suffix == "K" || suffix == "k") {
+            n <<= 10;
+            suffix.clear();
+        }
+        bool number = !value.empty() && suffix.empty() && n >= 0;
+        bool ok = number;
+        if (key == "channels") {
+            config.channels = n;
+            ok = number && n > 0;
+        } else if (key == "banks") {
+            config.banks = n;
+            ok = number && n > 0;
+        } else if (key == "row") {
+            config.rowSize = n;
+            ok = number && n >= 64 && (n & (n-1)) == 0;
+        } else if (key == "cas") {
+            config.tCAS = n;
+        } else if (key == "rcd") {
+            config.tRCD = n;
+        } else if (key == "rp") {
+            config.tRP = n;
+        } else if (key == "burst") {
+            config.tBurst = n;
+            ok = number && n > 0;
+        } else if (key == "queue") {
+            config.queueSize = n;
+            ok = number && n > 0;
+        } else if (key == "page") {
+            ok = (value == "open" || value == "closed");
+            config.openPage = (value == "open");
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            error = "bad DRAM field \"" + field + "\"";
+            return false;
+        }
+    }
+    return true;
+}
+
+void DRAMController::configure(const DRAMConfig &c) {
+    config = c;
+    active = true;
+    bank.assign(c.channels*c.banks, {false, 0, 0});
+    busFreeAt.assign(c.channels, 0);
+}
+
+uint64_t DRAMController::enqueue(uint32_t address, bool write, uint64_t arrival) {
+    schedule(arrival);
+    uint32_t chunk = address / config.rowSize;
+    DRAMRequest r;
+    r.id = nextId++;
+    r.write = write;
+    r.arrival = arrival;
+    r.channel = chunk % config.channels;
+    r.bank = (chunk / config.channels) % config.banks;
+    r.row = chunk / config.channels / config.banks;
+
+    // A full queue holds the new request back until the next one to go has started
+    if ((int)queue.size() >= config.queueSize) {
+        uint64_t at;
+        int n = next(at);
+        r.arrival = max(r.arrival, at);
+        issue(queue[n]);
+        queue.erase(queue.begin() + n);
+    }
+    queue.push_back(r);
+    schedule(clock);
+    return r.id;
+}
+
+uint64_t DRAMController::startTime(const DRAMRequest &r) {
+    return max(r.arrival, bank[r.channel*config.banks + r.bank].readyAt);
+}
+
+int DRAMController::pick(uint64_t limit) {
+    int best = -1;
+    bool bestHit = false;
+    for (int i = 0; i < (int)queue.size(); i++) {
+        const DRAMRequest &r = queue[i];
+        const DRAMBank &b = bank[r.channel*config.banks + r.bank];
+        if (startTime(r) > limit) {
+            continue;
+        }
+        // row hits first, then the oldest
+        bool hit = b.open && b.row == r.row;
+        if (best < 0 || (hit && !bestHit) || (hit == bestHit && r.arrival < queue[best].arrival)) {
+            best = i;
+            bestHit = hit;
+        }
+    }
+    return best;
+}
+
+int DRAMController::next(uint64_t &at) {
+    at = UINT64_MAX;
+    for (const DRAMRequest &r : queue) {
+        at = min(at, startTime(r));
+    }
+    return pick(at);
+}
+
+void DRAMController::issue(const DRAMRequest &r) {
+    DRAMBank &b = bank[r.channel*config.banks + r.bank];
+    uint64_t start = startTime(r);
+    int latency;
+    if (b.open && b.row == r.row) {
+        latency = config.tCAS;
+        rowHits++;
+    } else if (!b.open) {
+        latency = config.tRCD + config.tCAS;
+        rowMisses++;
+    } else {
+        latency = config.tRP + config.tRCD + config.tCAS;
+        rowConflicts++;
+    }
+    uint64_t data = max(start + latency, busFreeAt[r.channel]);
+    uint64_t finish = data + config.tBurst;
+    busFreeAt[r.channel] = finish;
+    if (config.openPage) {
+        b.open = true;
+        b.row = r.row;
+        b.readyAt = start + latency;
+    } else {
+        b.open = false;
+        b.readyAt = finish + config.tRP;
+    }
+    DEBUG(*out << "DRAM: " << (r.write ? "write" : "read") << " channel " << r.channel << " bank " << r.bank
+               << " row " << r.row << " at cycle " << start << ", data at " << data << "\n");
+    if (r.write) {
+        writes++;
+    } else {
+        reads++;
+        readLatency += finish - r.arrival;
+        done[r.id] = finish;
+    }
+}
+
+void DRAMController::schedule(uint64_t now) {
+    clock = max(clock, now);
+    uint64_t at;
+    for (int n = next(at); n >= 0 && at <= clock; n = next(at)) {
+        issue(queue[n]);
+        queue.erase(queue.begin() + n);
+    }
+}
+
+bool DRAMController::complete(uint64_t id, uint64_t now) {
+    schedule(now);
+    auto it = done.find(id);
+    if (it == done.end() || it->second > now) {
+        return false;
+    }
+    done.erase(it);
+    return true;
+}
+
+uint64_t DRAMController::finish(uint64_t id) {
+    uint64_t start;
+    while (!done.count(id) && next(start) >= 0) {
+        schedule(start);
+    }
+    uint64_t at = done[id];
+    done.erase(id);
+    return at;
+}
+
+void DRAMController::printStats(ostream &out) {
+    uint64_t accesses = rowHits + rowMisses + rowConflicts;
+    out << std::setw(8) << "DRAM" << ": " << reads << " reads, " << writes << " writes, "
+        << rowHits << " row buffer hits, " << rowMisses << " misses, " << rowConflicts << " conflicts";
+    if (accesses) {
+        out << std::fixed << std::setprecision(2) << " (" << 100.0*rowHits/accesses << "% hit rate)";
+    }
+    if (reads) {
+        out << std::fixed << std::setprecision(2) << ", " << (double)readLatency/reads << " cycles average read latency";
+    }
+    out << std::defaultfloat << "\n";
+}
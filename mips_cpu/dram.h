@@ -0,0 +1,111 @@
+#ifndef DRAMCONTROLLER
+#define DRAMCONTROLLER
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <cstdint>
+#include <iostream>
+
+// Geometry and timing (in processor cycles) of the DRAM behind the last cache level
+struct DRAMConfig {
+    int channels;
+    int banks;              // per channel
+    int rowSize;            // bytes in one row buffer
+    int tCAS;               // column access: a row buffer hit
+    int tRCD;               // activate: opening a row in a precharged bank
+    int tRP;                // precharge: closing the open row first
+    int tBurst;             // cycles one line holds the channel's data bus
+    int queueSize;          // requests waiting for their bank
+    bool openPage;          // false: close (precharge) the row after every access
+};
+
+// One channel, 8 banks of 2KB rows, 14-cycle tCAS/tRCD/tRP, 4-cycle bursts, 16-entry queue,
+// open page
+DRAMConfig defaultDRAM();
+
+// Applies "key=value,..." with keys channels, banks, row (K suffix allowed), cas, rcd, rp,
+// burst, queue, page=open|closed; an empty spec keeps the defaults
+bool applyDRAMSpec(DRAMConfig &config, const std::string &spec, std::string &error);
+
+struct DRAMRequest {
+    uint64_t id;
+    bool write;
+    uint64_t arrival;       // cycle the request reaches the controller
+    int channel;
+    int bank;
+    uint32_t row;
+};
+
+struct DRAMBank {
+    bool open;
+    uint32_t row;           // open row, if any
+    uint64_t readyAt;       // first cycle the bank takes another command
+};
+
+// Memory controller with an FR-FCFS queue: among the requests whose bank is free, a row buffer
+// hit goes first, then the oldest. Addresses map row:bank:channel:column, so consecutive lines
+// share a row. Each channel's data bus moves one line per tBurst cycles, which caps bandwidth.
+// Requests are scheduled lazily, up to the latest cycle anybody asked about, but in time order:
+// each choice is made when a bank frees up, among the requests that had arrived by then.
+class DRAMController {
+    private:
+        DRAMConfig config;
+        bool active;
+        std::deque<DRAMRequest> queue;
+        std::vector<DRAMBank> bank;             // channel-major
+        std::vector<uint64_t> busFreeAt;        // per channel
+        std::map<uint64_t, uint64_t> done;      // read id -> cycle its data is back
+        uint64_t clock;
+        uint64_t nextId;
+        uint64_t reads;
+        uint64_t writes;
+        uint64_t rowHits;
+        uint64_t rowMisses;                     // bank precharged, row had to be opened
+        uint64_t rowConflicts;                  // another row open, had to be closed first
+        uint64_t readLatency;                   // summed arrival-to-data cycles of the reads
+        std::ostream *out;                      // debug log
+
+        uint64_t enqueue(uint32_t address, bool write, uint64_t arrival);
+        // Earliest cycle the request could start on its bank
+        uint64_t startTime(const DRAMRequest &r);
+        // FR-FCFS pick among requests that can start by cycle limit, or -1
+        int pick(uint64_t limit);
+        // The request to issue next, or -1 if the queue is empty; at is the first cycle any
+        // request can start, and the pick is made among those that can start then
+        int next(uint64_t &at);
+        void issue(const DRAMRequest &r);
+        void schedule(uint64_t now);
+    public:
+        DRAMController() {
+            active = false;
+            clock = nextId = 0;
+            reads = writes = rowHits = rowMisses = rowConflicts = readLatency = 0;
+            out = &std::cout;
+        }
+        void setOutput(std::ostream *o) {
+            out = o;
+        }
+        void configure(const DRAMConfig &c);
+        bool enabled() {
+            return active;
+        }
+
+        // A line read arriving at cycle now; returns the id to poll with complete()
+        uint64_t read(uint32_t address, uint64_t now) {
+            return enqueue(address, false, now);
+        }
+        // A posted write back arriving at cycle now: takes bank and bus time, nobody waits for it
+        void write(uint32_t address, uint64_t now) {
+            enqueue(address, true, now);
+        }
+        // True once the read's data is back by cycle now (then the id is forgotten)
+        bool complete(uint64_t id, uint64_t now);
+        // Issues requests until the read has started; returns the cycle its data is back (then
+        // the id is forgotten)
+        uint64_t finish(uint64_t id);
+
+        void printStats(std::ostream &out);
+};
+
+#endif
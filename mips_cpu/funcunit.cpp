@@ -0,0 +1,132 @@
+#include <string>
+#include <sstream>
+#include <cstdlib>
+#include <algorithm>
+#include "funcunit.h"
+
+#ifdef ENABLE_DEBUG
+#define DEBUG(x) x
+#else
+#define DEBUG(x)
+#endif
+
+using namespace std;
+
+UnitConfig defaultUnits() {
+    return {4, true, 32, false};
+}
+
+bool applyUnitSpec(UnitConfig &config, const string &spec, string &error) {
+    string fields = spec;
+    for (char &ch : fields) {
+        if (ch == ',') {
+            ch = ' ';
+        }
+    }
+    istringstream in(fields);
+    string field;
+    while (in >> field) {
+        size_t eq = field.find('=');
+        string key = field.substr(0, eq);
+        string value = (eq == string::npos) ? "" : field.substr(eq+1);
+        char *end;
+        long n = strtol(value.c_str(), &end, 10);
+        bool number = !value.empty() && !*end && n > 0;
+        bool yesno = (value == "yes" || value == "no");
+        bool ok;
+        if (key == "mult") {
+            config.multLatency = n;
+            ok = number;
+        } else if (key == "div") {
+            config.divLatency = n;
+            ok = number;
+        } else if (key == "mult-pipelined") {
+            config.multPipelined = (value == "yes");
+            ok = yesno;
+        } else if (key == "div-pipelined") {
+            config.divPipelined = (value == "yes");
+            ok = yesno;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            error = "bad functional unit field \"" + field + "\"";
+            return false;
+        }
+    }
+    return true;
+}
+
+// mult, multu go to the multiplier, div, divu to the divider; mfhi, mflo, mthi, mtlo use neither
+FunctionalUnit *MultDivUnits::unit(int funct) {
+    if (funct == 0x18 || funct == 0x19) {
+        return &multiplier;
+    }
+    if (funct == 0x1a || funct == 0x1b) {
+        return &divider;
+    }
+    return NULL;
+}
+
+bool MultDivUnits::mustWait(int funct) {
+    FunctionalUnit *u = unit(funct);
+    if (u && !u->free(now + 1)) {
+        u->busyStalls++;
+        return true;
+    }
+    if ((funct == 0x10 || funct == 0x12) && readyAt > now + 1) {
+        hiloStalls++;
+        return true;
+    }
+    return false;
+}
+
+uint32_t MultDivUnits::execute(int funct, uint32_t rs_value, uint32_t rt_value) {
+    FunctionalUnit *u = unit(funct);
+    // Values are computed here and held back until readyAt; mfhi and mflo never read them early
+    switch (funct) {
+        case 0x10: return hi;                                                   // mfhi
+        case 0x12: return lo;                                                   // mflo
+        case 0x11: hi = rs_value; break;                                        // mthi
+        case 0x13: lo = rs_value; break;                                        // mtlo
+        case 0x18: {                                                            // mult
+            int64_t product = (int64_t)(int32_t)rs_value * (int32_t)rt_value;
+            hi = (uint64_t)product >> 32;
+            lo = product;
+            break;
+        }
+        case 0x19: {                                                            // multu
+            uint64_t product = (uint64_t)rs_value * rt_value;
+            hi = product >> 32;
+            lo = product;
+            break;
+        }
+        case 0x1a:                                                              // div
+            // Dividing by zero leaves what a restoring divider would; -2^31 / -1 wraps
+            if (!rt_value) {
+                hi = rs_value;
+                lo = 0xffffffff;
+            } else if (rs_value == 0x80000000 && rt_value == 0xffffffff) {
+                hi = 0;
+                lo = rs_value;
+            } else {
+                hi = (int32_t)rs_value % (int32_t)rt_value;
+                lo = (int32_t)rs_value / (int32_t)rt_value;
+            }
+            break;
+        case 0x1b:                                                              // divu
+            hi = rt_value ? rs_value % rt_value : rs_value;
+            lo = rt_value ? rs_value / rt_value : 0xffffffff;
+            break;
+        default: break;
+    }
+    readyAt = max(readyAt, u ? u->issue(now) : now + 1);
+    DEBUG(*out << "HI/LO: funct 0x" << std::hex << funct << std::dec << " issued, ready at cycle " << readyAt << "\n");
+    return 0;
+}
+
+void MultDivUnits::printStats(ostream &out) {
+    out << "Multiply/divide: " << multiplier.ops << " multiplies, " << divider.ops << " divides, "
+        << hiloStalls << " cycles stalled for HI/LO, " << multiplier.busyStalls + divider.busyStalls
+        << " cycles stalled for a busy unit\n";
+}
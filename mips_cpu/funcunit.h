@@ -0,0 +1,105 @@
+#ifndef FUNCUNIT
+#define FUNCUNIT
+#include <string>
+#include <cstdint>
+#include <iostream>
+
+// Latency (cycles from issue in EX until the result can be read) and issue rate of the
+// long-latency units
+struct UnitConfig {
+    int multLatency;
+    bool multPipelined;     // false: busy until the operation in flight is done
+    int divLatency;
+    bool divPipelined;
+};
+
+// A 4-cycle pipelined multiplier and a 32-cycle iterative divider (one quotient bit per cycle)
+UnitConfig defaultUnits();
+
+// Applies "key=value,..." with keys mult, div (latencies) and mult-pipelined,
+// div-pipelined=yes|no
+bool applyUnitSpec(UnitConfig &config, const std::string &spec, std::string &error);
+
+// One execution unit. A pipelined unit takes a new operation every cycle, an iterative one
+// only once the last one has finished.
+class FunctionalUnit {
+    private:
+        int latency;
+        bool pipelined;
+        uint64_t freeAt;                // first cycle it takes another operation
+    public:
+        uint64_t ops;
+        uint64_t busyStalls;            // cycles an operation waited for the unit to free up
+
+        FunctionalUnit() {
+            latency = 1;
+            pipelined = true;
+            freeAt = 0;
+            ops = busyStalls = 0;
+        }
+        void configure(int cycles, bool is_pipelined) {
+            latency = cycles;
+            pipelined = is_pipelined;
+        }
+        bool free(uint64_t cycle) {
+            return cycle >= freeAt;
+        }
+        // Starts an operation at cycle now; returns the cycle its result is ready
+        uint64_t issue(uint64_t now) {
+            ops++;
+            freeAt = pipelined ? now + 1 : now + latency;
+            return now + latency;
+        }
+};
+
+// The multiplier and divider behind mult, multu, div and divu, and the HI/LO pair they write.
+// EX issues an operation and goes on; the pair is only waited for by mfhi and mflo, so
+// independent instructions keep flowing while a product or quotient is being computed.
+// Results land in program order: a fast multiply does not overtake a slow divide.
+class MultDivUnits {
+    private:
+        FunctionalUnit multiplier;
+        FunctionalUnit divider;
+        uint32_t hi;
+        uint32_t lo;
+        uint64_t readyAt;               // cycle the newest HI/LO write lands
+        uint64_t now;
+        uint64_t hiloStalls;
+        std::ostream *out;              // debug log
+
+        FunctionalUnit *unit(int funct);
+    public:
+        MultDivUnits() {
+            hi = lo = 0;
+            readyAt = now = 0;
+            hiloStalls = 0;
+            out = &std::cout;
+            configure(defaultUnits());
+        }
+        void setOutput(std::ostream *o) {
+            out = o;
+        }
+        void configure(const UnitConfig &config) {
+            multiplier.configure(config.multLatency, config.multPipelined);
+            divider.configure(config.divLatency, config.divPipelined);
+        }
+        void tick() {
+            now++;
+        }
+        bool used() {
+            return multiplier.ops || divider.ops;
+        }
+
+        // True if the HI/LO instruction with this funct, in ID now, could not start in EX next
+        // cycle: its unit is busy, or mfhi/mflo would read a result still being computed.
+        // Each true counts a stall cycle.
+        bool mustWait(int funct);
+
+        // Runs mult, multu, div, divu, mthi or mtlo on R[rs] and R[rt], or returns HI or LO
+        // for mfhi or mflo
+        uint32_t execute(int funct, uint32_t rs_value, uint32_t rt_value);
+
+        void printStats(std::ostream &out);
+};
+
+#endif
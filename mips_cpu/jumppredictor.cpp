@@ -0,0 +1,91 @@
+#include <cstdint>
+#include <iostream>
+#include "jumppredictor.h"
+
+using namespace std;
+
+static bool isJumpRegister(uint32_t instruction) {
+    return !(instruction >> 26) && (instruction & 0x3f) == 0x08;
+}
+
+static int jumpRegister(uint32_t instruction) {
+    return (instruction >> 21) & 0x1f;
+}
+
+void JumpPredictor::update(uint32_t pc, uint32_t instruction, uint32_t target) {
+    int opcode = instruction >> 26;
+    int n = ras.size();
+    if (opcode == 0x3 && n) {
+        // jal returns past its delay slot
+        top = (top+1) % n;
+        ras[top] = pc + 8;
+        depth += depth < n;
+    } else if (isJumpRegister(instruction) && jumpRegister(instruction) == 31 && depth) {
+        top = (top+n-1) % n;
+        depth--;
+    }
+    if (target != pc + 4) {
+        history = (history << 2) ^ (target >> 2);
+    }
+}
+
+uint32_t JumpPredictor::predict(uint32_t pc, uint32_t instruction, PredictorCheckpoint &checkpoint) {
+    checkpoint.top = top;
+    checkpoint.depth = depth;
+    checkpoint.topValue = ras.empty() ? 0 : ras[top];
+    checkpoint.history = history;
+
+    int opcode = instruction >> 26;
+    uint32_t target = pc + 4;
+    if (opcode == 0x2 || opcode == 0x3) {
+        target = ((pc + 4) & 0xf0000000) | ((instruction & 0x3ffffff) << 2);
+    } else if (isJumpRegister(instruction)) {
+        if (jumpRegister(instruction) == 31 && depth) {
+            target = ras[top];
+        } else if (!targets.empty()) {
+            IndirectTarget &t = targets[targetIndex(pc, history)];
+            if (t.valid && t.pc == pc) {
+                target = t.target;
+            }
+        }
+    }
+    update(pc, instruction, target);
+    return target;
+}
+
+void JumpPredictor::resolve(uint32_t pc, uint32_t instruction, const PredictorCheckpoint &checkpoint,
+                            uint32_t predicted, uint32_t actual) {
+    int opcode = instruction >> 26;
+    if (opcode == 0x2 || opcode == 0x3) {
+        directJumps++;
+    } else if (isJumpRegister(instruction) && jumpRegister(instruction) == 31 && checkpoint.depth) {
+        returns++;
+        returnHits += (predicted == actual);
+    } else if (isJumpRegister(instruction)) {
+        indirects++;
+        indirectHits += (predicted == actual);
+        if (!targets.empty()) {
+            targets[targetIndex(pc, checkpoint.history)] = {true, pc, actual};
+        }
+    }
+    if (predicted == actual) {
+        return;
+    }
+
+    // Everything fetched after this instruction is being squashed
+    repairs++;
+    top = checkpoint.top;
+    depth = checkpoint.depth;
+    if (!ras.empty()) {
+        ras[top] = checkpoint.topValue;
+    }
+    history = checkpoint.history;
+    update(pc, instruction, actual);
+}
+
+void JumpPredictor::printStats(ostream &out) {
+    out << "Jump predictor: " << directJumps << " direct jumps taken at fetch, "
+        << returnHits << "/" << returns << " returns and "
+        << indirectHits << "/" << indirects << " other jr predicted, "
+        << repairs << " redirects\n";
+}
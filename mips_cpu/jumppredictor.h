@@ -0,0 +1,78 @@
+#ifndef JUMPPREDICTOR
+#define JUMPPREDICTOR
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+// Speculative predictor state as fetch found it before an instruction, so a redirect in EX
+// can put it back and redo just that instruction's part
+struct PredictorCheckpoint {
+    int top;                // RAS slot of the newest return address
+    int depth;              // valid RAS entries
+    uint32_t topValue;      // entry at top, which a wrong-path push may have overwritten
+    uint32_t history;       // path history
+};
+
+struct IndirectTarget {
+    bool valid;
+    uint32_t pc;            // jr the entry was trained by
+    uint32_t target;
+};
+
+// Fetch-stage target prediction. Fetch looks at every instruction it gets: j and jal go straight
+// to their target (jal also pushes its return address), jr $31 pops the return address stack,
+// and other jr use an indirect target cache indexed by PC xor the path of recent taken targets.
+// Conditional branches are still predicted not taken.
+class JumpPredictor {
+    private:
+        std::vector<uint32_t> ras;              // circular: overflow overwrites the oldest
+        int top;
+        int depth;
+        std::vector<IndirectTarget> targets;
+        uint32_t history;
+        uint64_t directJumps;
+        uint64_t returns;
+        uint64_t returnHits;
+        uint64_t indirects;
+        uint64_t indirectHits;
+        uint64_t repairs;                   // mispredictions fixed up, from ID or EX
+
+        // PC xor the whole path history, folded down to the index width
+        int targetIndex(uint32_t pc, uint32_t path) {
+            uint32_t mask = targets.size()-1;
+            uint32_t index = pc >> 2;
+            for (; path && mask; path >>= __builtin_popcount(mask)) {
+                index ^= path;
+            }
+            return index & mask;
+        }
+
+        // The speculative state change of instruction at pc, going next to target
+        void update(uint32_t pc, uint32_t instruction, uint32_t target);
+    public:
+        JumpPredictor() {
+            top = depth = 0;
+            history = 0;
+            directJumps = returns = returnHits = indirects = indirectHits = repairs = 0;
+        }
+        // ras_entries return addresses; target_entries (a power of two) indirect targets
+        void configure(int ras_entries, int target_entries) {
+            ras.assign(ras_entries, 0);
+            targets.assign(target_entries, {false, 0, 0});
+        }
+        bool enabled() {
+            return !ras.empty() || !targets.empty();
+        }
+
+        // Next PC to fetch after the instruction at pc; checkpoint gets the state before it
+        uint32_t predict(uint32_t pc, uint32_t instruction, PredictorCheckpoint &checkpoint);
+
+        // The instruction resolved in EX and really goes to actual next. Trains the indirect
+        // target cache, and on a misprediction rolls the speculative state back to checkpoint.
+        void resolve(uint32_t pc, uint32_t instruction, const PredictorCheckpoint &checkpoint,
+                     uint32_t predicted, uint32_t actual);
+
+        void printStats(std::ostream &out);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include "loopbuffer.h"
+
+#ifdef ENABLE_DEBUG
+#define DEBUG(x) x
+#else
+#define DEBUG(x)
+#endif
+
+using namespace std;
+
+bool LoopBuffer::fetch(uint32_t pc, uint32_t &instruction, control_t &control) {
+    if (state != LOOP_STREAMING || !inLoop(pc) || !entries[(pc - start)/4].valid) {
+        return false;
+    }
+    LoopBufferEntry &e = entries[(pc - start)/4];
+    instruction = e.instruction;
+    control = e.control;
+    streamed++;
+    return true;
+}
+
+void LoopBuffer::capture(uint32_t pc, uint32_t instruction) {
+    fetched++;
+    if (state == LOOP_IDLE || !inLoop(pc)) {
+        return;
+    }
+    // Only straight-line bodies: a jump would take fetch somewhere the buffer cannot follow
+    int opcode = (instruction >> 26) & 0x3f;
+    if (opcode == 0x2 || opcode == 0x3 || (!opcode && (instruction & 0x3f) == 0x08)) {
+        DEBUG(*out << "Loop buffer: jump in loop at 0x" << std::hex << start << std::dec << ", giving up\n");
+        stop();
+        return;
+    }
+    LoopBufferEntry &e = entries[(pc - start)/4];
+    e.valid = true;
+    e.instruction = instruction;
+    e.control.decode(instruction);
+    if (state == LOOP_CAPTURING && pc == end) {
+        DEBUG(*out << "Loop buffer: streaming loop 0x" << std::hex << start << "-0x" << end << std::dec << "\n");
+        state = LOOP_STREAMING;
+        loops++;
+    }
+}
+
+uint32_t LoopBuffer::predict(uint32_t pc) {
+    return (state == LOOP_STREAMING && pc == end) ? start : pc + 4;
+}
+
+void LoopBuffer::resolve(uint32_t pc, bool branch, uint32_t next_pc) {
+    if (state != LOOP_IDLE) {
+        // Leaving the loop: falling out of the closing branch, or any other way out
+        if ((pc == end && next_pc != start) || (next_pc != pc + 4 && !inLoop(next_pc))) {
+            DEBUG(*out << "Loop buffer: left loop 0x" << std::hex << start << "-0x" << end << std::dec << "\n");
+            exits += (state == LOOP_STREAMING);
+            stop();
+        }
+        return;
+    }
+    if (!branch || next_pc >= pc || (pc - next_pc)/4 + 1 > (uint32_t)capacity) {
+        if (pc == end) {
+            iterations = 0;
+        }
+        return;
+    }
+    if (pc != end || next_pc != start) {
+        start = next_pc;
+        end = pc;
+        iterations = 0;
+    }
+    if (++iterations >= LOOP_BUFFER_DETECT) {
+        state = LOOP_CAPTURING;
+        entries.assign((end - start)/4 + 1, LoopBufferEntry());
+    }
+}
+
+void LoopBuffer::printStats(ostream &out) {
+    uint64_t total = fetched + streamed;
+    out << "Loop buffer: " << streamed << " of " << total << " fetches streamed";
+    if (total) {
+        out << " (" << std::fixed << std::setprecision(2) << 100.0*streamed/total << "% coverage)" << std::defaultfloat;
+    }
+    out << " from " << loops << " loops, " << exits << " exits\n";
+}
@@ -0,0 +1,85 @@
+#ifndef LOOPBUFFER
+#define LOOPBUFFER
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include "control.h"
+
+// Taken iterations of the same backward branch before its loop body is captured
+#define LOOP_BUFFER_DETECT 2
+
+// One instruction of the captured loop, kept decoded
+struct LoopBufferEntry {
+    bool valid;
+    uint32_t instruction;
+    control_t control;
+};
+
+enum LoopBufferState {
+    LOOP_IDLE,          // watching backward branches for a loop that fits
+    LOOP_CAPTURING,     // copying the body as fetch brings it in from the L1
+    LOOP_STREAMING      // fetch reads the body from here and the closing branch is predicted taken
+};
+
+// Loop stream detector: a backward branch taken LOOP_BUFFER_DETECT times in a row over a body
+// of at most `capacity` instructions without jumps gets its body captured on the next pass.
+// Fetch then streams that body from here without touching the L1I, going back to the top
+// without a bubble, until the loop exits (a slot a forward branch skipped during capture is
+// fetched from the L1 once and kept).
+class LoopBuffer {
+    private:
+        std::vector<LoopBufferEntry> entries;   // one per instruction from start to end
+        int capacity;                           // 0: no loop buffer
+        LoopBufferState state;
+        uint32_t start;                         // first instruction of the loop
+        uint32_t end;                           // the backward branch closing it
+        int iterations;                         // taken in a row so far by the candidate at end
+        uint64_t fetched;
+        uint64_t streamed;
+        uint64_t loops;
+        uint64_t exits;
+        std::ostream *out;                      // debug log
+
+        bool inLoop(uint32_t pc) {
+            return pc >= start && pc <= end;
+        }
+        void stop() {
+            state = LOOP_IDLE;
+            iterations = 0;
+        }
+    public:
+        LoopBuffer() {
+            capacity = 0;
+            state = LOOP_IDLE;
+            start = end = 0;
+            iterations = 0;
+            fetched = streamed = loops = exits = 0;
+            out = &std::cout;
+        }
+        void setCapacity(int num_entries) {
+            capacity = num_entries;
+        }
+        void setOutput(std::ostream *o) {
+            out = o;
+        }
+        bool enabled() {
+            return capacity > 0;
+        }
+
+        // Instruction at pc, already decoded, if the loop being streamed holds it
+        bool fetch(uint32_t pc, uint32_t &instruction, control_t &control);
+
+        // An instruction fetch brought in from the L1; kept if it belongs to the captured loop
+        void capture(uint32_t pc, uint32_t instruction);
+
+        // Next PC after the instruction at pc while streaming: the top of the loop after its
+        // closing branch
+        uint32_t predict(uint32_t pc);
+
+        // A branch or jump at pc resolved in EX and goes on to next_pc
+        void resolve(uint32_t pc, bool branch, uint32_t next_pc);
+
+        void printStats(std::ostream &out);
+};
+
+#endif
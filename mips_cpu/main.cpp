@@ -11,6 +11,9 @@
 #include <errno.h>
 #include <getopt.h>
 #include "processor.h"
+#include "multicore.h"
+#include "stackdist.h"
+#include "trace.h"
 /* tanmai and jay */
 using namespace std;
 
@@ -79,7 +82,59 @@ void print_help()
             "-O2                                  Optimization Level 2 (custom optimization TBD; includes O1)\n"
             "-O3                                  Optimization Level 3 (custom optimization TBD; includes O2)\n"
             "-O4                                  Optimization Level 4 (custom optimization TBD; includes O3)\n"
-            "                                     Defaults to -O0\n";
+            "                                     Defaults to -O0\n"
+            "--cores <n>                          Number of cores, each with a private L1 kept coherent (MESI)\n"
+            "                                     over the shared L2. Every core runs the benchmark from PC 0\n"
+            "                                     with its core id in $k0 ($26). Defaults to 1\n"
+            "--quantum <cycles>                   Cycles each core simulates on its own host thread before\n"
+            "                                     synchronizing with the others. Misses and writes other\n"
+            "                                     cores see take effect at the next sync, in a fixed order,\n"
+            "                                     so runs are reproducible. A core waiting on a miss stops\n"
+            "                                     its clock until then, so a miss costs the same at any\n"
+            "                                     quantum, but other cores see writes later with a longer\n"
+            "                                     one. Defaults to 100\n"
+            "--stack-distance                     Profile the L1 reference streams and report LRU and OPT hit\n"
+            "                                     ratios for every cache geometry (sets x ways) in one run,\n"
+            "                                     for instruction fetches and for loads and stores\n"
+            "--record-trace <path>                Record every completed memory access (pc, address, read or\n"
+            "                                     write, instruction or data) for the replay tool; a path\n"
+            "                                     ending in .gz is compressed with gzip. At most 32 cores\n"
+            "--cache-stats                        Report accesses and misses of every cache\n"
+            "--cache-config <path>                Build the cache hierarchy (O1 and above) from a file, one\n"
+            "                                     level per line, innermost first. The first level is private\n"
+            "                                     to each core, the others are shared. Defaults to a 32KB 8-way\n"
+            "                                     L1I and L1D per core (12 cycle miss penalty each) and a 256KB\n"
+            "                                     8-way inclusive L2 (59). Add --cache=L1,split=no for a single\n"
+            "                                     unified L1, which fetches and data accesses share\n"
+            "--cache <name>,<key>=<value>,...     Change the level with that name, or add it as the outermost\n"
+            "                                     one. Keys: size (K/M suffix), assoc, line, penalty (cycles to\n"
+            "                                     get a line from further out on a miss), write=back|through,\n"
+            "                                     allocate=yes|no, inclusion=inclusive|exclusive|nine,\n"
+            "                                     split=yes|no (first level only: an L1I and an L1D of this\n"
+            "                                     geometry per core, the default, or one unified L1)\n"
+            "--store-buffer <lines>               Pipelined processor: stores retire into a write-combining\n"
+            "                                     buffer of this many L1 lines that drains in the background,\n"
+            "                                     and loads forward from it. Defaults to 0 (no buffer)\n"
+            "--ras <entries>                      Pipelined processor: predict jumps at fetch, with a return\n"
+            "                                     address stack of this many entries for jr $31\n"
+            "--indirect-targets <entries>         Same, with an indirect target cache of this many entries\n"
+            "                                     (a power of two) for other jr. Both default to 0 (jumps\n"
+            "                                     are resolved in EX)\n"
+            "--loop-buffer <entries>              Pipelined processor: stream loops of up to this many\n"
+            "                                     instructions from a loop buffer instead of the L1I.\n"
+            "                                     Defaults to 0 (no loop buffer)\n"
+            "--dram[=<key>=<value>,...]           Time misses that reach memory with a banked DRAM model instead\n"
+            "                                     of the last level's penalty (O1 and above). Keys: channels,\n"
+            "                                     banks, row (bytes per row, K suffix), cas, rcd, rp, burst\n"
+            "                                     (cycles per line on a channel), queue, page=open|closed\n"
+            "--early-branches                     Pipelined processor: resolve beq, bne, j and jal in ID with\n"
+            "                                     an equality comparator (one squashed instruction instead of\n"
+            "                                     two, at the cost of stalls for operands not ready in ID)\n"
+            "--units <key>=<value>,...            Pipelined processor: latency and issue rate of the units\n"
+            "                                     behind mult, div and HI/LO. Keys: mult, div (cycles until\n"
+            "                                     mfhi/mflo can read the result), mult-pipelined=yes|no,\n"
+            "                                     div-pipelined=yes|no. Defaults to a 4-cycle pipelined\n"
+            "                                     multiplier and a 32-cycle iterative divider\n";
 }
 
 int main(int argc, char *argv[]) {
@@ -91,6 +146,20 @@ int main(int argc, char *argv[]) {
       {"opt2", optional_argument, 0, '2'},
       {"opt3", optional_argument, 0, '3'},
       {"opt4", optional_argument, 0, '4'},
+      {"cores", required_argument, 0, 'c'},
+      {"quantum", required_argument, 0, 'q'},
+      {"stack-distance", no_argument, 0, 's'},
+      {"record-trace", required_argument, 0, 't'},
+      {"cache-stats", no_argument, 0, 'S'},
+      {"cache-config", required_argument, 0, 'C'},
+      {"cache", required_argument, 0, 'L'},
+      {"store-buffer", required_argument, 0, 'B'},
+      {"ras", required_argument, 0, 'R'},
+      {"indirect-targets", required_argument, 0, 'I'},
+      {"loop-buffer", required_argument, 0, 'P'},
+      {"early-branches", no_argument, 0, 'E'},
+      {"dram", optional_argument, 0, 'D'},
+      {"units", required_argument, 0, 'U'},
       {"help", no_argument, 0, 'h'}
     };
     int option_index = 0;
@@ -101,9 +170,27 @@ int main(int argc, char *argv[]) {
     uint32_t end_pc = 0;
 
     int optLevel = 0;
+    int numCores = 1;
+    uint64_t quantum = 100;
+    bool stackDistance = false;
+    StackDistanceProfiler profiler;
+    string tracePath;
+    TraceWriter tracer;
+    bool cacheStats = false;
+    string cacheConfigPath;
+    vector<string> cacheSpecs;
+    int storeBufferEntries = 0;
+    int rasEntries = 0;
+    int indirectTargets = 0;
+    int loopBufferEntries = 0;
+    bool earlyBranches = false;
+    bool useDRAM = false;
+    DRAMConfig dramConfig = defaultDRAM();
+    UnitConfig unitConfig = defaultUnits();
+    string error;
 
     while (true) {
-      char c = getopt_long(argc, argv, "b:O01234h", long_options, &option_index);
+      char c = getopt_long(argc, argv, "b:O01234hc:q:st:SC:L:B:R:I:P:ED::U:", long_options, &option_index);
       if (c == -1) {
           if (!initialized) {
               print_help();
@@ -121,6 +208,79 @@ int main(int argc, char *argv[]) {
               break;
           case 'O':
               break;
+          case 'c':
+              numCores = atoi(optarg);
+              if (numCores < 1) {
+                  cout << "Invalid number of cores: " << optarg << "\n";
+                  exit(1);
+              }
+              break;
+          case 'q':
+              quantum = strtoull(optarg, NULL, 10);
+              if (quantum < 1) {
+                  cout << "Invalid quantum: " << optarg << "\n";
+                  exit(1);
+              }
+              break;
+          case 's':
+              stackDistance = true;
+              break;
+          case 't':
+              tracePath = optarg;
+              break;
+          case 'S':
+              cacheStats = true;
+              break;
+          case 'C':
+              cacheConfigPath = optarg;
+              break;
+          case 'L':
+              cacheSpecs.push_back(optarg);
+              break;
+          case 'B':
+              storeBufferEntries = atoi(optarg);
+              if (storeBufferEntries < 0) {
+                  cout << "Invalid store buffer size: " << optarg << "\n";
+                  exit(1);
+              }
+              break;
+          case 'R':
+              rasEntries = atoi(optarg);
+              if (rasEntries < 0) {
+                  cout << "Invalid return address stack size: " << optarg << "\n";
+                  exit(1);
+              }
+              break;
+          case 'I':
+              indirectTargets = atoi(optarg);
+              if (indirectTargets < 0 || (indirectTargets & (indirectTargets-1))) {
+                  cout << "Invalid indirect target cache size: " << optarg << "\n";
+                  exit(1);
+              }
+              break;
+          case 'P':
+              loopBufferEntries = atoi(optarg);
+              if (loopBufferEntries < 0) {
+                  cout << "Invalid loop buffer size: " << optarg << "\n";
+                  exit(1);
+              }
+              break;
+          case 'E':
+              earlyBranches = true;
+              break;
+          case 'D':
+              useDRAM = true;
+              if (optarg && !applyDRAMSpec(dramConfig, optarg, error)) {
+                  cout << "Invalid DRAM: " << error << "\n";
+                  exit(1);
+              }
+              break;
+          case 'U':
+              if (!applyUnitSpec(unitConfig, optarg, error)) {
+                  cout << "Invalid functional units: " << error << "\n";
+                  exit(1);
+              }
+              break;
           case '0':
           case '1':
           case '2':
@@ -133,14 +293,68 @@ int main(int argc, char *argv[]) {
       }
     }
 
+    vector<CacheConfig> hierarchy;
+    if (!buildHierarchy(cacheConfigPath, cacheSpecs, hierarchy, error)) {
+        cout << "Invalid cache hierarchy: " << error << "\n";
+        exit(1);
+    }
     memory.setOptLevel(optLevel);
+    memory.setHierarchy(hierarchy);
+    memory.setNumCores(numCores);
+    if (useDRAM) {
+        memory.setDRAM(dramConfig);
+    }
+    if (stackDistance) {
+        memory.setProfiler(&profiler);
+    }
+    if (!tracePath.empty()) {
+        if (numCores > TRACE_MAX_CORES) {
+            cout << "Traces hold at most " << TRACE_MAX_CORES << " cores\n";
+            exit(1);
+        }
+        if (!tracer.open(tracePath, numCores)) {
+            cout << "Failed to create trace: " << tracePath << "\n";
+            exit(1);
+        }
+        memory.setTracer(&tracer);
+    }
     uint64_t num_cycles = 0;
-    while (processor.getPC() <= end_pc) {
-        processor.advance();
-        cout << "\nCYCLE " << num_cycles << "\n";
-        processor.printRegFile();
-        num_cycles++;
+    vector<Processor*> cores(1, &processor);
+    for (int i = 1; i < numCores; i++) {
+        cores.push_back(new Processor(&memory, i));
+        cores.back()->initialize(optLevel);
+    }
+    for (Processor *core : cores) {
+        core->setStoreBuffer(storeBufferEntries);
+        core->setJumpPredictor(rasEntries, indirectTargets);
+        core->setLoopBuffer(loopBufferEntries);
+        core->setEarlyBranches(earlyBranches);
+        core->setUnits(unitConfig);
+    }
+    if (numCores > 1) {
+        num_cycles = run_multicore(memory, cores, end_pc, quantum);
+    } else {
+        while (processor.getPC() <= end_pc) {
+            processor.advance();
+            cout << "\nCYCLE " << num_cycles << "\n";
+            processor.printRegFile();
+            num_cycles++;
+        }
     }
 
     cout << "\nCompleted execution in " << (double)num_cycles*(optLevel ? 1 : 125)*0.5 << " nanoseconds.\n";
+    if (stackDistance) {
+        profiler.report(cout);
+    }
+    if (cacheStats) {
+        cout << "\nCache statistics:\n";
+        memory.printStats(cout);
+    }
+    memory.printDRAMStats(cout);
+    for (Processor *core : cores) {
+        core->printStats(cout);
+    }
+    for (int i = 1; i < numCores; i++) {
+        delete cores[i];
+    }
 }
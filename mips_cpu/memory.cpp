@@ -1,8 +1,12 @@
 #include <vector>
 #include <cstdint>
 #include <iostream>
+#include <iomanip>
 #include <cmath>
+#include <algorithm>
 #include "memory.h"
+#include "stackdist.h"
+#include "trace.h"
 
 #ifdef ENABLE_DEBUG
 #define DEBUG(x) x
@@ -12,6 +16,28 @@
 
 using namespace std;
 
+// Returns true (and burns one cycle) while a miss is still being serviced
+bool Cache::stalled() {
+    if (missQueued) {
+        missWaited++;
+        return true;
+    }
+    if (!missCountdown) {
+        return false;
+    }
+    DEBUG(*out << name + " Cache (miss) at address " << std::hex << missAddress << std::dec << ": " << missCountdown << " cycles remaining to be serviced\n");
+    missCountdown--;
+    return true;
+}
+
+void Cache::printStats(std::ostream &out) {
+    out << std::setw(8) << name << ": " << accesses << " accesses, " << misses << " misses";
+    if (accesses) {
+        out << " (" << std::fixed << std::setprecision(2) << 100.0*misses/accesses << "% miss rate)" << std::defaultfloat;
+    }
+    out << "\n";
+}
+
 // Check if hit in the cache
 bool Cache::isHit(uint32_t address, uint32_t &loc) {
     int idx = getIndex(address);
@@ -27,6 +53,22 @@ bool Cache::isHit(uint32_t address, uint32_t &loc) {
     return false;
 }
 
+// The line holding this address, or NULL
+CacheLine *Cache::lookup(uint32_t address, bool update_lru) {
+    int idx = getIndex(address);
+    int tag = getTag(address);
+
+    for (int w=0; w<assoc; w++) {
+        if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
+            if (update_lru) {
+                updateReplacementBits(idx, w);
+            }
+            return &line[idx*assoc+w];
+        }
+    }
+    return NULL;
+}
+
 // Update replacement bits after access
 void Cache::updateReplacementBits(int idx, int way) {
     uint8_t curRepl = line[idx*assoc+way].replBits;
@@ -40,37 +82,26 @@ void Cache::updateReplacementBits(int idx, int way) {
 // Read a word from this cache
 bool Cache::read(uint32_t address, uint32_t &read_data) {
     uint32_t loc = 0;
-    if (missCountdown) {
-        DEBUG(cout << name + " Cache (read miss) at address " << std::hex << address << std::dec << ": " << missCountdown << " cycles remaining to be serviced\n");
-        missCountdown--;
-        return false;
-    }
-    // Once miss penalty is completely paid, isHit should return true
     if (!isHit(address, loc)) {
-        missCountdown = missPenalty-1;
         return false;
     }
     read_data = line[loc].data[getOffset(address)/4]; 
-    DEBUG(cout << name + " Cache (read hit): " << read_data << "<-[" << std::hex << address << std::dec << "]\n");
+    DEBUG(*out << name + " Cache (read hit): " << read_data << "<-[" << std::hex << address << std::dec << "]\n");
     return true;
 }
 
 // Write a word to this cache
-bool Cache::write(uint32_t address, uint32_t write_data) {
+bool Cache::write(uint32_t address, uint32_t write_data, uint32_t byte_mask) {
     uint32_t loc = 0;
-    if (missCountdown) {
-        DEBUG(cout << name + " Cache (write miss) at address " << std::hex << address << std::dec << ": " << missCountdown << " cycles remaining to be serviced\n");
-        missCountdown--;
+    // A SHARED line has to be upgraded before it can be written
+    if (!isHit(address, loc) || line[loc].state == MESI_SHARED) {
         return false;
     }
-    // Once miss penalty is completely paid, isHit should return true
-    if (!isHit(address, loc)) {
-        missCountdown = missPenalty-1;
-        return false;
-    }
-    line[loc].data[getOffset(address)/4] = write_data;
+    uint32_t &word = line[loc].data[getOffset(address)/4];
+    word = (word & ~byte_mask) | (write_data & byte_mask);
     line[loc].dirty = true; 
-    DEBUG(cout << name + " Cache (write hit): [" << std::hex << address << std::dec << "]<-" << write_data << "\n");
+    line[loc].state = MESI_MODIFIED;
+    DEBUG(*out << name + " Cache (write hit): [" << std::hex << address << std::dec << "]<-" << write_data << "\n");
     return true;
 }
 
@@ -85,29 +116,31 @@ CacheLine Cache::readLine(uint32_t address) {
         }
     }
     CacheLine c;
+    c.address = 0;
+    c.tag = 0;
     c.valid = false;
+    c.dirty = false;
+    c.replBits = 0;
+    c.state = MESI_INVALID;
     return c;
 }
 
 // Call this only if you know that a valid line with matching tag exists at that address 
-void Cache::writeBackLine(CacheLine evictedLine) {
-    int idx = getIndex(evictedLine.address);
-    int tag = getTag(evictedLine.address);
-
-    for (int w=0; w<assoc; w++) {
-        if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
-            for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
-                line[idx*assoc+w].data[i] = evictedLine.data[i];
-            }
-            line[idx*assoc+w].dirty = true;
+void Cache::writeBackLine(const CacheLine &evictedLine) {
+    CacheLine *l = lookup(evictedLine.address);
+    if (l) {
+        int offset = getOffset(evictedLine.address)/4;
+        for (int i = 0; i < (int)evictedLine.data.size(); i++) {
+            l->data[offset+i] = evictedLine.data[i];
         }
+        l->dirty = true;
     }
 }
 
 // Replace a line at the set corresponding this address
 void Cache::replace(uint32_t address, CacheLine newLine, CacheLine &evictedLine) {
     int idx = getIndex(address);
-    newLine.address = address;
+    newLine.address = address & ~(lineSize-1);
     newLine.tag = getTag(address);
     newLine.valid = true;
    
@@ -120,9 +153,12 @@ void Cache::replace(uint32_t address, CacheLine newLine, CacheLine &evictedLine)
     /* Replace. */ 
     for (int w=0; w<assoc; w++) {
         if (!line[idx*assoc+w].valid || line[idx*assoc+w].replBits == 0) {
-            DEBUG(cout << name + " Cache: replacing line at idx:" << idx << " way:" << w << " due to conflicting address:" << std::hex << address << std::dec << "\n");
+            DEBUG(*out << name + " Cache: replacing line at idx:" << idx << " way:" << w << " due to conflicting address:" << std::hex << address << std::dec << "\n");
             evictedLine = line[idx*assoc+w];
             line[idx*assoc+w] = newLine;
+            /* The incoming line becomes the most recently used. */
+            line[idx*assoc+w].replBits = 0;
+            updateReplacementBits(idx, w);
             return;
         }
     }
@@ -136,17 +172,329 @@ void Cache::invalidateLine(uint32_t address) {
     for (int w=0; w<assoc; w++) {
         if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
             line[idx*assoc+w].valid = false;
+            line[idx*assoc+w].state = MESI_INVALID;
+        }
+    }
+}
+
+// Coherence state of the line holding this address
+MESIState Cache::getState(uint32_t address) {
+    CacheLine *c = lookup(address);
+    return c ? c->state : MESI_INVALID;
+}
+
+// Change the coherence state of a present line
+void Cache::setState(uint32_t address, MESIState state) {
+    int idx = getIndex(address);
+    int tag = getTag(address);
+
+    for (int w=0; w<assoc; w++) {
+        if (line[idx*assoc+w].valid && line[idx*assoc+w].tag == tag) {
+            line[idx*assoc+w].state = state;
+            line[idx*assoc+w].dirty = (state == MESI_MODIFIED);
+        }
+    }
+}
+
+bool Memory::access(uint32_t address, uint32_t &read_data, uint32_t write_data, bool mem_read, bool mem_write, int core, uint32_t pc) {
+    if (!serve(core, address, read_data, write_data, 0xffffffff, mem_read, mem_write)) {
+        return false;
+    }
+    if (mem_read || mem_write) {
+        observe(core, pc, address, mem_write, false);
+    }
+    return true;
+}
+
+bool Memory::write(uint32_t address, uint32_t write_data, uint32_t byte_mask, int core, uint32_t pc) {
+    uint32_t dummy_word;
+    if (!serve(core, address, dummy_word, write_data, byte_mask, false, true)) {
+        return false;
+    }
+    observe(core, pc, address, true, false);
+    return true;
+}
+
+bool Memory::writeLine(uint32_t address, const std::vector<uint32_t> &data, const std::vector<uint32_t> &mask, int core, uint32_t pc) {
+    uint32_t lineAddr = address & lineMask();
+    int first = 0;
+    while (first < (int)mask.size() && !mask[first]) {
+        first++;
+    }
+    if (first == (int)mask.size()) {
+        return true;
+    }
+    // The first word pays for the line, then the rest go into it in the same access
+    uint32_t dummy_word;
+    if (!serve(core, lineAddr+4*first, dummy_word, data[first], mask[first], false, true)) {
+        return false;
+    }
+    for (int i = first+1; i < (int)mask.size(); i++) {
+        if (mask[i]) {
+            writeWord(core, lineAddr+4*i, data[i], mask[i]);
+        }
+    }
+    observe(core, pc, lineAddr+4*first, true, false);
+    return true;
+}
+
+bool Memory::fetch(uint32_t pc, uint32_t &instruction, int core) {
+    bool done = splitL1() ? serveFetch(core, pc, instruction) : serve(core, pc, instruction, 0, 0, true, false);
+    if (!done) {
+        return false;
+    }
+    observe(core, pc, pc, false, true);
+    return true;
+}
+
+bool Memory::loadLinked(uint32_t address, uint32_t &read_data, int core, uint32_t pc) {
+    if (!serve(core, address, read_data, 0, 0, true, false)) {
+        return false;
+    }
+    observe(core, pc, address, false, false);
+    linkAddress[core] = address;
+    linkValid[core] = true;
+    return true;
+}
+
+bool Memory::storeConditional(uint32_t address, uint32_t write_data, bool &success, int core, uint32_t pc) {
+    uint32_t dummy_word;
+    // The reservation is checked again in the cycle the store completes, so a conflicting
+    // write from another core during the miss still makes the sc fail
+    if (!linkValid[core] || (linkAddress[core] & lineMask()) != (address & lineMask())) {
+        if (opt_level && !finishMiss(core)) {
+            return false;
+        }
+        DEBUG(*out[core] << "Core " << core << ": sc to [" << std::hex << address << std::dec << "] failed\n");
+        linkValid[core] = false;
+        success = false;
+        return true;
+    }
+    // It reads the line too, so a miss brings it into the L1 even when stores go around it:
+    // two sc's written around their L1s in one quantum would both succeed
+    if (!serve(core, address, dummy_word, write_data, 0xffffffff, true, true)) {
+        return false;
+    }
+    observe(core, pc, address, true, false);
+    linkValid[core] = false;
+    success = true;
+    return true;
+}
+
+void Memory::observe(int core, uint32_t pc, uint32_t address, bool mem_write, bool instruction) {
+    if (profiler || tracer) {
+        MemoryEvent e(EVENT_OBSERVE, core, address, pc);
+        e.write = mem_write;
+        e.instruction = instruction;
+        post(e);
+    }
+}
+
+void Memory::post(MemoryEvent e) {
+    e.cycle = cycle[e.core];
+    if (quantum) {
+        pending[e.core].push_back(e);
+    } else {
+        apply(e);
+    }
+}
+
+void Memory::setOutput(int core, std::ostream *o) {
+    out[core] = o;
+    level[0][core].setOutput(o);
+    if (!icache.empty()) {
+        icache[core].setOutput(o);
+    }
+    logTo(core);
+}
+
+void Memory::logTo(int core) {
+    log = out[core];
+    for (int l = 1; l < (int)level.size(); l++) {
+        level[l][0].setOutput(log);
+    }
+    dram.setOutput(log);
+}
+
+void Memory::apply(const MemoryEvent &e) {
+    if (quantum) {
+        logTo(e.core);
+    }
+    servedAt = e.cycle;
+    switch (e.kind) {
+        case EVENT_MISS: {
+            Cache &l1 = e.instruction ? icache[e.core] : level[0][e.core];
+            startMiss(l1, e.core, e.address, e.write, e.allocate, e.instruction, e.cycle);
+            break;
+        }
+        case EVENT_WRITE_THROUGH:
+            writeBelow(1, e.address, &e.word, 1);
+            break;
+        case EVENT_WRITE_AROUND:
+            writeAround(e.core, e.address, e.word, e.byteMask);
+            break;
+        case EVENT_BREAK_LINKS:
+            breakLinks(e.core, e.address);
+            break;
+        case EVENT_OBSERVE:
+            if (profiler) {
+                profiler->record(e.core, e.address, e.instruction);
+            }
+            if (tracer) {
+                TraceRecord r = {e.word, e.address, e.write, e.instruction, e.core};
+                tracer->write(r);
+            }
+            break;
+    }
+}
+
+void Memory::sync() {
+    // Oldest first; what cores did in the same cycle goes in core order, and each core's
+    // events stay in program order
+    std::vector<MemoryEvent> events;
+    for (std::vector<MemoryEvent> &p : pending) {
+        events.insert(events.end(), p.begin(), p.end());
+        p.clear();
+    }
+    auto older = [](const MemoryEvent &a, const MemoryEvent &b) { return a.cycle < b.cycle; };
+    std::stable_sort(events.begin(), events.end(), older);
+    std::vector<bool> deferred(pending.size(), false);
+    for (const MemoryEvent &e : events) {
+        // A store going around its L1 could take away a line placed for another core before
+        // that core used it: it waits for the next sync, with everything its core did after it
+        if (deferred[e.core] || (e.kind == EVENT_WRITE_AROUND && disturbs(e.address))) {
+            deferred[e.core] = true;
+            pending[e.core].push_back(e);
+            continue;
+        }
+        apply(e);
+    }
+
+    // Then the lines that are due, oldest miss first (L1D before L1I, then core order, within
+    // a cycle). A line placed for a load or store sits in the L1D until the core retries, and
+    // no other core's fill that could take it away goes before then, or a spinning reader
+    // could take back the line of a waiting sc at every sync.
+    std::vector<MemoryEvent> due;
+    for (int c = 0; c < (int)level[0].size(); c++) {
+        MemoryEvent m(EVENT_MISS, c, 0);
+        if (fillDue(level[0][c], false, m)) {
+            due.push_back(m);
+        }
+        if (!icache.empty() && fillDue(icache[c], true, m)) {
+            due.push_back(m);
+        }
+    }
+    std::stable_sort(due.begin(), due.end(), older);
+    for (const MemoryEvent &m : due) {
+        Cache &l1 = m.instruction ? icache[m.core] : level[0][m.core];
+        uint64_t request;
+        bool memory = l1.waitingOn(request);
+        if ((m.allocate && disturbs(m.address)) || (memory && !l1.waitingForSync())) {
+            continue;
+        }
+        // The core stopped when its read reached the controller, and stalls on from there
+        // until the data is back
+        if (memory) {
+            uint64_t at = dram.finish(request);
+            l1.stallFor(at > cycle[m.core] ? at - cycle[m.core] : 0);
+        }
+        l1.filled();
+        logTo(m.core);
+        if (m.allocate && m.instruction) {
+            fillInstruction(m.core, m.address);
+        } else if (m.allocate) {
+            fill(m.core, m.address, m.write);
+        }
+    }
+}
+
+bool Memory::fillDue(Cache &l1, bool instruction, MemoryEvent &m) {
+    if (!l1.readyToFill(quantum, m.address, m.write, m.allocate, m.cycle)) {
+        return false;
+    }
+    m.instruction = instruction;
+    return true;
+}
+
+bool Memory::disturbs(uint32_t address) {
+    // The L1 being filled holds nothing yet. An instruction line only counts while its core
+    // can fetch it: not with a load or store of its own still waiting for the sync.
+    for (int c = 0; c < (int)level[0].size(); c++) {
+        uint32_t held;
+        if ((level[0][c].holding(held) && conflicts(held, address)) ||
+            (!icache.empty() && !level[0][c].awaitingFill() && icache[c].holding(held) && conflicts(held, address))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Memory::conflicts(uint32_t a, uint32_t b) {
+    if ((a & lineMask()) == (b & lineMask())) {
+        return true;
+    }
+    for (int l = 1; l < (int)level.size(); l++) {
+        if (level[l][0].getIndex(a) == level[l][0].getIndex(b)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Memory::printStats(std::ostream &out) {
+    for (Cache &cache : icache) {
+        cache.printStats(out);
+    }
+    for (int l = 0; l < (int)level.size(); l++) {
+        for (int c = 0; c < (int)level[l].size(); c++) {
+            level[l][c].printStats(out);
+        }
+    }
+}
+
+void Memory::printDRAMStats(std::ostream &out) {
+    if (dram.enabled()) {
+        dram.printStats(out);
+    }
+}
+
+void Memory::breakLinks(int core, uint32_t address) {
+    for (int c = 0; c < (int)linkValid.size(); c++) {
+        if (c != core && linkValid[c] &&
+            (linkAddress[c] & lineMask()) == (address & lineMask())) {
+            linkValid[c] = false;
         }
     }
 }
 
-bool Memory::access(uint32_t address, uint32_t &read_data, uint32_t write_data, bool mem_read, bool mem_write) {
+void Memory::wrote(int core, uint32_t address) {
+    post(MemoryEvent(EVENT_BREAK_LINKS, core, address));
+    if (!config[0].writeBack) {
+        CacheLine *l = level[0][core].lookup(address);
+        post(MemoryEvent(EVENT_WRITE_THROUGH, core, address, l->data[(address - l->address)/4]));
+        level[0][core].setState(address, MESI_EXCLUSIVE);
+    }
+}
+
+void Memory::writeWord(int core, uint32_t address, uint32_t write_data, uint32_t byte_mask) {
+    if (opt_level == 0) {
+        mem[address/4] = (mem[address/4] & ~byte_mask) | (write_data & byte_mask);
+        post(MemoryEvent(EVENT_BREAK_LINKS, core, address));
+    } else if (level[0][core].write(address, write_data, byte_mask)) {
+        wrote(core, address);
+    } else {
+        post(MemoryEvent(EVENT_WRITE_AROUND, core, address, write_data, byte_mask));
+        post(MemoryEvent(EVENT_BREAK_LINKS, core, address));
+    }
+}
+
+bool Memory::serve(int core, uint32_t address, uint32_t &read_data, uint32_t write_data, uint32_t byte_mask, bool mem_read, bool mem_write) {
     if (opt_level == 0) {
         if (mem_read) {
             read_data = mem[address/4];
         }
         if (mem_write) {
-            mem[address/4] = write_data;
+            writeWord(core, address, write_data, byte_mask);
         }
         return true;
     }
@@ -155,41 +503,382 @@ bool Memory::access(uint32_t address, uint32_t &read_data, uint32_t write_data,
         return true;
     }
 
-    if ((mem_read && L1.read(address, read_data)) || (mem_write && L1.write(address, write_data))) {
+    // Still paying off an earlier miss
+    Cache &l1 = level[0][core];
+    if (busy(l1, core)) {
+        return false;
+    }
+
+    // The miss paid off: the line arrives now (with a quantum, the sync placed it already),
+    // so nobody can steal it before it is used
+    uint32_t missAddress;
+    bool missExclusive;
+    bool missAllocate;
+    bool retry = l1.missServiced(missAddress, missExclusive, missAllocate);
+    if (retry && missAllocate && !quantum) {
+        fill(core, missAddress, missExclusive);
+    } else if (retry && !missAllocate && mem_write && address == missAddress) {
+        post(MemoryEvent(EVENT_WRITE_AROUND, core, address, write_data, byte_mask));
+        post(MemoryEvent(EVENT_BREAK_LINKS, core, address));
         return true;
-    } else if ((mem_read && L2.read(address, read_data)) || (mem_write && L2.write(address, write_data))) {
-        // Read from L2 but don't return a success status until miss penalty is paid off completely
-        CacheLine evictedLine;
-        L1.replace(address, L2.readLine(address), evictedLine);
+    }
 
-        // writeback dirty line
-        if (evictedLine.valid && evictedLine.dirty) {
-            L2.writeBackLine(evictedLine);
+    if ((!mem_read || l1.read(address, read_data)) && (!mem_write || l1.write(address, write_data, byte_mask))) {
+        if (mem_write) {
+            wrote(core, address);
         }
-    } else {
-        // Read from memory but don't return a success status until miss penalty is paid off completely
-        int lineAddr = address & ~(CACHE_LINE_SIZE-1);
-        CacheLine c;
-        CacheLine evictedLine;
-        evictedLine.valid = false;
-        DEBUG(print(lineAddr, 8));
-        for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
-           c.data[i] = mem[lineAddr/4+i];
+        if (!retry) {
+            l1.recordAccess(true);
+        }
+        return true;
+    }
+
+    // Don't return a success status until miss penalty is paid off completely
+    l1.recordAccess(false);
+    bool allocate = mem_read || config[0].writeAllocate || l1.lookup(address);
+    requestMiss(l1, core, address, mem_write, allocate, false);
+    return false;
+}
+
+bool Memory::serveFetch(int core, uint32_t pc, uint32_t &instruction) {
+    Cache &l1i = icache[core];
+    if (busy(l1i, core)) {
+        return false;
+    }
+
+    uint32_t missAddress;
+    bool missExclusive;
+    bool missAllocate;
+    bool retry = l1i.missServiced(missAddress, missExclusive, missAllocate);
+    if (retry && !quantum) {
+        fillInstruction(core, missAddress);
+    }
+
+    if (l1i.read(pc, instruction)) {
+        if (!retry) {
+            l1i.recordAccess(true);
         }
-        L2.replace(address, c, evictedLine); 
+        return true;
+    }
+
+    l1i.recordAccess(false);
+    requestMiss(l1i, core, pc, false, true, true);
+    return false;
+}
+
+bool Memory::finishMiss(int core) {
+    Cache &l1 = level[0][core];
+    if (busy(l1, core)) {
+        return false;
+    }
+    uint32_t address;
+    bool exclusive;
+    bool allocate;
+    if (l1.missServiced(address, exclusive, allocate) && allocate && !quantum) {
+        fill(core, address, exclusive);
+    }
+    return true;
+}
+
+bool Memory::busy(Cache &l1, int core) {
+    if (l1.stalled()) {
+        return true;
+    }
+    // With a quantum, only a sync places the line, once DRAM has it
+    if (quantum) {
+        return l1.awaitingFill();
+    }
+    uint64_t request;
+    return l1.waitingOn(request) && !dram.complete(request, cycle[core]);
+}
 
-        // model an inclusive hierarchy
-        if (evictedLine.valid) {
-            L1.invalidateLine(evictedLine.address);
+void Memory::requestMiss(Cache &l1, int core, uint32_t address, bool exclusive, bool allocate, bool instruction) {
+    if (quantum) {
+        l1.queueMiss(address, exclusive, allocate, cycle[core]);
+    }
+    MemoryEvent e(EVENT_MISS, core, address);
+    e.write = exclusive;
+    e.allocate = allocate;
+    e.instruction = instruction;
+    post(e);
+}
+
+void Memory::startMiss(Cache &l1, int core, uint32_t address, bool exclusive, bool allocate, bool instruction, uint64_t now) {
+    bool memory;
+    int cycles = missLatency(core, address, exclusive, instruction, memory);
+    if (!memory || !dram.enabled()) {
+        l1.startMiss(address, exclusive, allocate, cycles);
+        return;
+    }
+    // Getting to the controller costs what a hit in the last level would; a store that does
+    // not allocate is written out as it passes, so only line reads wait for DRAM
+    int toController = config.size() > 1 ? config[config.size()-2].penalty : 1;
+    l1.startMiss(address, exclusive, allocate, toController);
+    if (allocate) {
+        l1.waitFor(dram.read(address & ~(uint32_t)(config.back().lineSize-1), now + toController));
+    }
+}
+
+int Memory::missLatency(int core, uint32_t address, bool exclusive, bool instruction, bool &memory) {
+    // The line comes from the nearest place that holds it, at the penalty of the last
+    // level that missed; an upgrade or another L1 costs the L1 miss penalty
+    memory = false;
+    if (exclusive && level[0][core].getState(address) == MESI_SHARED) {
+        return config[0].penalty;
+    }
+    for (int c = 0; c < (int)level[0].size() && !instruction; c++) {
+        if (c != core && level[0][c].lookup(address)) {
+            return config[0].penalty;
         }
+    }
+    for (int l = 1; l < (int)level.size(); l++) {
+        if (level[l][0].lookup(address)) {
+            return config[l-1].penalty;
+        }
+    }
+    memory = true;
+    return config.back().penalty;
+}
 
+void Memory::snoop(int core, uint32_t address, bool exclusive, bool &shared) {
+    // A MODIFIED copy is written back first, then every copy is either invalidated
+    // (write) or downgraded to SHARED (read)
+    shared = false;
+    for (int c = 0; c < (int)level[0].size(); c++) {
+        if (c == core) {
+            continue;
+        }
+        CacheLine *peer = level[0][c].lookup(address);
+        if (!peer) {
+            continue;
+        }
+        if (peer->dirty) {
+            writeBelow(1, peer->address, peer->data.data(), peer->data.size());
+        }
+        if (exclusive) {
+            DEBUG(*out[core] << "Core " << core << ": invalidating " << std::hex << address << std::dec << " in core " << c << "\n");
+            level[0][c].invalidateLine(address);
+        } else {
+            level[0][c].setState(address, MESI_SHARED);
+            shared = true;
+        }
+    }
+}
+
+void Memory::fill(int core, uint32_t address, bool exclusive) {
+    Cache &l1 = level[0][core];
+    servedAt = cycle[core];
+    bool shared;
+    snoop(core, address, exclusive, shared);
+
+    // Upgrade: the line is already here, only ownership was missing
+    if (l1.getState(address) == MESI_SHARED) {
+        if (exclusive) {
+            l1.setState(address, MESI_EXCLUSIVE);
+        }
+        return;
+    }
+
+    std::vector<uint32_t> block(l1.getLineSize()/4);
+    bool dirty = fetchBlock(1, address, block);
+    if (dirty && shared) {
+        // other readers hold it too, so nobody may own the dirty data up here
+        writeBelow(1, address & lineMask(), block.data(), block.size());
+        dirty = false;
+    }
+
+    // E if no one else holds it (or we are about to write), S otherwise
+    CacheLine c;
+    CacheLine evictedLine;
+    evictedLine.valid = false;
+    c.data = block;
+    c.dirty = dirty;
+    c.state = dirty ? MESI_MODIFIED : (exclusive || !shared) ? MESI_EXCLUSIVE : MESI_SHARED;
+    l1.replace(address, c, evictedLine);
+    if (evictedLine.valid) {
+        evict(0, evictedLine);
+    }
+}
+
+void Memory::fillInstruction(int core, uint32_t address) {
+    Cache &l1i = icache[core];
+    servedAt = cycle[core];
+    std::vector<uint32_t> block(l1i.getLineSize()/4);
+    if (fetchBlock(1, address, block)) {
+        // an L1I never writes back, so dirty data handed up by an exclusive level goes on out
+        writeBelow(1, address & lineMask(), block.data(), block.size());
+    }
+
+    CacheLine c;
+    CacheLine evictedLine;
+    evictedLine.valid = false;
+    c.data = block;
+    c.dirty = false;
+    c.state = MESI_SHARED;
+    l1i.replace(address, c, evictedLine);
+    if (evictedLine.valid) {
+        evict(0, evictedLine);
+    }
+}
+
+bool Memory::fetchBlock(int lvl, uint32_t address, std::vector<uint32_t> &data) {
+    uint32_t base = address & ~(uint32_t)(data.size()*4-1);
+    if (lvl == (int)level.size()) {
+        // Read from memory
+        DEBUG(print(base/4, data.size(), *log));
+        for (int i = 0; i < (int)data.size(); i++) {
+            data[i] = mem[base/4+i];
+        }
+        return false;
+    }
+
+    Cache &cache = level[lvl][0];
+    bool exclusive = (config[lvl].inclusion == EXCLUSIVE);
+    CacheLine *l = cache.lookup(address, true);
+    cache.recordAccess(l != NULL);
+    if (l) {
+        for (int i = 0; i < (int)data.size(); i++) {
+            data[i] = l->data[(base - l->address)/4+i];
+        }
+        // an exclusive level hands the line, and ownership of its data, to the level above
+        bool dirty = exclusive && l->dirty;
+        if (exclusive) {
+            cache.invalidateLine(address);
+        }
+        return dirty;
+    }
+
+    std::vector<uint32_t> block(cache.getLineSize()/4);
+    bool dirty = fetchBlock(lvl+1, address, block);
+    if (!exclusive) {
+        insert(lvl, address, block, dirty);
+        dirty = false;
+    }
+    uint32_t lineAddr = address & ~(uint32_t)(cache.getLineSize()-1);
+    for (int i = 0; i < (int)data.size(); i++) {
+        data[i] = block[(base - lineAddr)/4+i];
+    }
+    return dirty;
+}
+
+void Memory::insert(int lvl, uint32_t address, const std::vector<uint32_t> &data, bool dirty) {
+    Cache &cache = level[lvl][0];
+    CacheLine c;
+    c.data = data;
+    c.address = address & ~(uint32_t)(cache.getLineSize()-1);
+    c.tag = cache.getTag(address);
+    c.valid = true;
+    c.replBits = 0;
+    c.dirty = dirty;
+    c.state = dirty ? MESI_MODIFIED : MESI_EXCLUSIVE;
+
+    // Still here (a victim from above that another core's copy kept alive): merge it
+    if (cache.lookup(address)) {
+        if (dirty) {
+            cache.writeBackLine(c);
+        }
+        return;
+    }
+
+    CacheLine evictedLine;
+    evictedLine.valid = false;
+    cache.replace(address, c, evictedLine);
+    if (evictedLine.valid) {
+        evict(lvl, evictedLine);
+    }
+}
+
+void Memory::evict(int lvl, CacheLine &victim) {
+    // model an inclusive level: the victim leaves every level above too, taking along any
+    // newer data a dirty copy holds (innermost last, it has the newest)
+    if (lvl > 0 && config[lvl].inclusion == INCLUSIVE) {
+        for (int l = lvl-1; l >= 0; l--) {
+            for (Cache &cache : level[l]) {
+                backInvalidate(cache, victim);
+            }
+        }
+        for (Cache &cache : icache) {
+            backInvalidate(cache, victim);
+        }
+    }
+
+    int next = lvl+1;
+    if (next < (int)level.size() && config[next].inclusion == EXCLUSIVE) {
+        // an exclusive level is filled by what the level above throws out
+        insert(next, victim.address, victim.data, victim.dirty);
+    } else if (victim.dirty) {
         // writeback dirty line
-        if (evictedLine.valid && evictedLine.dirty) {
-            lineAddr = evictedLine.address & ~(CACHE_LINE_SIZE-1);
-            for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
-               mem[lineAddr/4+i] = evictedLine.data[i];
+        writeBelow(next, victim.address, victim.data.data(), victim.data.size());
+    }
+}
+
+void Memory::backInvalidate(Cache &cache, CacheLine &victim) {
+    uint32_t end = victim.address + victim.data.size()*4;
+    for (uint32_t a = victim.address; a < end; a += cache.getLineSize()) {
+        CacheLine *inner = cache.lookup(a);
+        if (!inner) {
+            continue;
+        }
+        if (inner->dirty) {
+            for (int j = 0; j < (int)inner->data.size(); j++) {
+                victim.data[(inner->address - victim.address)/4+j] = inner->data[j];
             }
+            victim.dirty = true;
         }
+        cache.invalidateLine(a);
+    }
+}
+
+void Memory::writeBelow(int lvl, uint32_t address, const uint32_t *data, int words) {
+    for (; lvl < (int)level.size(); lvl++) {
+        CacheLine *l = level[lvl][0].lookup(address);
+        if (!l) {
+            continue;
+        }
+        for (int i = 0; i < words; i++) {
+            l->data[(address - l->address)/4+i] = data[i];
+        }
+        if (config[lvl].writeBack) {
+            l->dirty = true;
+            return;
+        }
+    }
+    for (int i = 0; i < words; i++) {
+        mem[address/4+i] = data[i];
+    }
+    if (dram.enabled()) {
+        dram.write(address, servedAt);
+    }
+}
+
+void Memory::writeAround(int core, uint32_t address, uint32_t word, uint32_t byte_mask) {
+    bool shared;
+    snoop(core, address, true, shared);
+
+    // The first level that holds the line, or that allocates on writes, takes the word;
+    // write-through levels pass it on
+    for (int lvl = 1; lvl < (int)level.size(); lvl++) {
+        Cache &cache = level[lvl][0];
+        CacheLine *l = cache.lookup(address, true);
+        cache.recordAccess(l != NULL);
+        if (!l && config[lvl].writeAllocate) {
+            std::vector<uint32_t> block(cache.getLineSize()/4);
+            bool dirty = fetchBlock(lvl+1, address, block);
+            insert(lvl, address, block, dirty);
+            l = cache.lookup(address);
+        }
+        if (!l) {
+            continue;
+        }
+        uint32_t &old = l->data[(address - l->address)/4];
+        old = (old & ~byte_mask) | (word & byte_mask);
+        if (config[lvl].writeBack) {
+            l->dirty = true;
+            return;
+        }
+    }
+    mem[address/4] = (mem[address/4] & ~byte_mask) | (word & byte_mask);
+    if (dram.enabled()) {
+        dram.write(address, servedAt);
     }
-    return false;
 }
@@ -4,16 +4,64 @@
 #include <cstdint>
 #include <iostream>
 #include <cmath>
+#include <string>
+#include <algorithm>
+#include "cacheconfig.h"
+#include "dram.h"
 
+// Line size of the default hierarchy and the granularity of the stack-distance profile
 #define CACHE_LINE_SIZE 64
 
+class StackDistanceProfiler;
+class TraceWriter;
+
+// MESI coherence state of a line held in a private L1
+enum MESIState {
+    MESI_INVALID,
+    MESI_SHARED,
+    MESI_EXCLUSIVE,
+    MESI_MODIFIED
+};
+
 struct CacheLine {
-    uint32_t data[CACHE_LINE_SIZE/4];
-    uint32_t address;
+    std::vector<uint32_t> data;
+    uint32_t address;       // of the first byte in the line
     int tag;
     bool valid;
     bool dirty;
     uint8_t replBits;
+    MESIState state;
+};
+
+// What a core did between two syncs that other cores or the shared levels have to see
+enum MemoryEventKind {
+    EVENT_MISS,             // an L1 miss to start
+    EVENT_WRITE_THROUGH,    // a word written into a write-through L1, for the levels below
+    EVENT_WRITE_AROUND,     // a store that missed a no-write-allocate L1
+    EVENT_BREAK_LINKS,      // a write, clearing other cores' reservations on its line
+    EVENT_OBSERVE           // a completed access, for the profiler and the trace recorder
+};
+
+struct MemoryEvent {
+    MemoryEventKind kind;
+    int core;
+    uint32_t address;
+    uint32_t word;          // data of a write, pc of an observed access
+    uint32_t byteMask;
+    uint64_t cycle;         // of the core that did it
+    bool write;             // miss for ownership, or observed write
+    bool allocate;
+    bool instruction;       // miss in the L1I, or observed fetch
+
+    MemoryEvent(MemoryEventKind k, int c, uint32_t a, uint32_t w = 0, uint32_t mask = 0) {
+        kind = k;
+        core = c;
+        address = a;
+        word = w;
+        byteMask = mask;
+        cycle = 0;
+        write = allocate = instruction = false;
+    }
 };
 
 class Cache {
@@ -21,52 +69,187 @@ class Cache {
         std::vector<CacheLine> line;
         int size;
         int assoc;
+        int lineSize;
         int missPenalty;
         int missCountdown;
+        bool missPending;
+        bool missExclusive;
+        bool missAllocate;
+        bool missDRAM;          // after the countdown, wait for this DRAM read too
+        bool missQueued;        // with a quantum: waiting for the next sync to start it
+        bool missFilled;        // with a quantum: the sync already placed the line
+        int missWaited;         // stalled cycles spent waiting for the sync
+        uint64_t missSince;     // with a quantum: core cycle the miss was found in
+        uint64_t missRequest;
+        uint32_t missAddress;
+        uint64_t accesses;
+        uint64_t misses;
         std::string name;
+        std::ostream *out;      // debug log
     public:
-        Cache(std::string nm, int sz, int asc, int penalty) {
+        Cache(std::string nm, int sz, int asc, int penalty, int line_size = CACHE_LINE_SIZE) {
             name = nm;
             size = sz;
             assoc = asc;
-            line.resize(size/CACHE_LINE_SIZE);
+            lineSize = line_size;
+            line.resize(size/lineSize);
 
-            for (int i = 0; i < (size/CACHE_LINE_SIZE); i++) {
+            for (int i = 0; i < (size/lineSize); i++) {
+                line[i].data.resize(lineSize/4);
                 line[i].valid = false;
+                line[i].dirty = false;
+                line[i].replBits = 0;
+                line[i].state = MESI_INVALID;
             }
             
             missCountdown = 0;
+            missPending = false;
+            missExclusive = false;
+            missAllocate = true;
+            missDRAM = false;
+            missQueued = false;
+            missFilled = false;
+            missWaited = 0;
+            missSince = 0;
+            missRequest = 0;
+            missAddress = 0;
             missPenalty = penalty;
+            accesses = 0;
+            misses = 0;
+            out = &std::cout;
+        }
+        void setOutput(std::ostream *o) {
+            out = o;
         }
 
         // offset, index, tag computation
         int getOffset(uint32_t address) {
-            return address & (CACHE_LINE_SIZE-1);
+            return address & (lineSize-1);
         }
         int getIndex(uint32_t address) {
-            return (address >> (int)log2(CACHE_LINE_SIZE)) & (size/CACHE_LINE_SIZE-1);
+            return (address >> (int)log2(lineSize)) & (size/(lineSize*assoc)-1);
         }
         int getTag(uint32_t address) {
-            return address >> (int)log2(size);
+            return address >> (int)log2(size/assoc);
+        }
+        int getLineSize() {
+            return lineSize;
+        }
+        int getMissPenalty() {
+            return missPenalty;
+        }
+
+        // Stall-on-miss bookkeeping: one outstanding miss keeps this cache busy for `cycles`
+        // cycles, counting the cycle in which it was detected. A miss that does not allocate
+        // (a write-no-allocate store) is completed further out instead of being filled.
+        void startMiss(uint32_t address, bool exclusive, bool allocate, int cycles) {
+            missPending = true;
+            missExclusive = exclusive;
+            missAllocate = allocate;
+            missAddress = address;
+            // cycles already spent waiting for the sync count towards the stall
+            missCountdown = std::max(cycles-1-missWaited, 0);
+            missDRAM = false;
+            missQueued = false;
+            missFilled = false;
+            missWaited = 0;
+        }
+
+        // With a quantum, a miss is only noted when it happens (at core cycle `since`): the
+        // cache stalls until the next sync starts it, and then until a sync has placed the line
+        void queueMiss(uint32_t address, bool exclusive, bool allocate, uint64_t since) {
+            startMiss(address, exclusive, allocate, 1);
+            missQueued = true;
+            missSince = since;
+        }
+        bool awaitingFill() {
+            return missPending && !missFilled;
+        }
+        // With a quantum: true while only a sync can move the miss on (it has not been started,
+        // or its stall is over and the line is not placed yet)
+        bool waitingForSync() {
+            return missPending && !missFilled && (missQueued || !missCountdown);
+        }
+        // Keeps the cache stalled for at least `cycles` more cycles
+        void stallFor(int cycles) {
+            missCountdown = std::max(missCountdown, cycles);
+        }
+        // True for a started miss that has not been filled yet and pays off in fewer than
+        // `within` more stalled cycles
+        bool readyToFill(uint64_t within, uint32_t &address, bool &exclusive, bool &allocate, uint64_t &since) {
+            if (!missPending || missQueued || missFilled || (uint64_t)missCountdown >= within) {
+                return false;
+            }
+            address = missAddress;
+            exclusive = missExclusive;
+            allocate = missAllocate;
+            since = missSince;
+            return true;
         }
+        void filled() {
+            missFilled = true;
+        }
+        // True, with its address, while the line a sync placed for our miss waits for the retry
+        // that uses it
+        bool holding(uint32_t &address) {
+            address = missAddress;
+            return missPending && missFilled && missAllocate;
+        }
+
+        // The pending miss also waits for a DRAM read
+        void waitFor(uint64_t request) {
+            missDRAM = true;
+            missRequest = request;
+        }
+        bool waitingOn(uint64_t &request) {
+            request = missRequest;
+            return missPending && missDRAM;
+        }
+
+        // Returns true (and burns one cycle) while a miss is still being serviced
+        bool stalled();
+
+        // Returns true once, after the countdown, for the miss that has to be filled now
+        bool missServiced(uint32_t &address, bool &exclusive, bool &allocate) {
+            if (!missPending) {
+                return false;
+            }
+            missPending = false;
+            address = missAddress;
+            exclusive = missExclusive;
+            allocate = missAllocate;
+            return true;
+        }
+
+        // Hit/miss statistics, one lookup per access (retries after a miss are not counted)
+        void recordAccess(bool hit) {
+            accesses++;
+            misses += !hit;
+        }
+        void printStats(std::ostream &out);
 
         // Check if hit in the cache
         bool isHit(uint32_t address, uint32_t &loc);
 
+        // The line holding this address, or NULL; a lookup only counts as a use with update_lru
+        CacheLine *lookup(uint32_t address, bool update_lru = false);
+
         // Update replacement bits after access
         void updateReplacementBits(int idx, int way);
 
-        // Read a word from this cache
+        // Read a word from this cache, returns false on a miss
         bool read(uint32_t address, uint32_t &read_data);
 
-        // Write a word to this cache
-        bool write(uint32_t address, uint32_t write_data);
+        // Write the bytes of a word selected by byte_mask, returns false on a miss or if the
+        // line is only SHARED
+        bool write(uint32_t address, uint32_t write_data, uint32_t byte_mask = 0xffffffff);
 
         // Call this only if you know that a valid line with matching tag exists at that address 
         CacheLine readLine(uint32_t address);
 
-        // Call this only if you know that a valid line with matching tag exists at that address 
-        void writeBackLine(CacheLine evictedLine);
+        // Call this only if you know that a valid line with matching tag exists at that address.
+        // The evicted line may be smaller than ours, it then overwrites just its part.
+        void writeBackLine(const CacheLine &evictedLine);
 
         // Replace a line at the set corresponding this address
         void replace(uint32_t address, CacheLine newLine, CacheLine &evictedLine);
@@ -74,6 +257,12 @@ class Cache {
         // Invalidate a line
         void invalidateLine(uint32_t address);
 
+        // Coherence state of the line holding this address (MESI_INVALID if absent)
+        MESIState getState(uint32_t address);
+
+        // Change the coherence state of a present line; leaving MODIFIED clears the dirty bit
+        void setState(uint32_t address, MESIState state);
+
         // Print a cache line
         void printLine(uint32_t address) {
             int idx = getIndex(address);
@@ -85,8 +274,9 @@ class Cache {
                     std::cout<< "Address:" << line[idx*assoc+w].address << "\n";
                     std::cout<< "Tag:" << line[idx*assoc+w].tag << "\n";
                     std::cout<< "Dirty:" << line[idx*assoc+w].dirty << "\n";
+                    std::cout<< "State:" << line[idx*assoc+w].state << "\n";
                     std::cout<< "Replacement Bits:" << line[idx*assoc+w].replBits << "\n";
-                    for (int i = 0; i < CACHE_LINE_SIZE/4; i++) {
+                    for (int i = 0; i < lineSize/4; i++) {
                         std::cout<< "DATA[" << i << "]: " << line[idx*assoc+w].data[i] << "\n";
                     }
                     return;
@@ -98,31 +288,253 @@ class Cache {
 class Memory {
     private:
         std::vector<uint32_t> mem;
-        Cache L1 = Cache("L1", 32768, 8, 12);
-        Cache L2 = Cache("L2", 262144, 8, 59);
+        std::vector<CacheConfig> config;        // innermost level first
+        // level[0] holds one private cache per core, kept coherent with MESI;
+        // every deeper level is a single cache shared by all cores
+        std::vector<std::vector<Cache>> level;
+        // one private L1I per core when the first level is split (level[0] then holds the
+        // L1Ds); instructions are read-only, so these stay out of MESI
+        std::vector<Cache> icache;
+        std::vector<uint32_t> linkAddress;  // LL/SC reservation per core
+        std::vector<char> linkValid;        // not vector<bool>: cores set their own concurrently
         int opt_level;
+        StackDistanceProfiler *profiler;    // sees every completed access when set
+        TraceWriter *tracer;                // records every completed access when set
+        // Cycles between syncs when cores run in separate host threads (0: one thread, and
+        // everything happens right away). Each core then only touches its own L1s until
+        // sync() applies what it queued here, in cycle order and core order within a cycle.
+        uint64_t quantum;
+        std::vector<std::vector<MemoryEvent>> pending;     // per core, in program order
+        // DRAM timing instead of the last level's fixed penalty, when enabled
+        DRAMController dram;
+        std::vector<uint64_t> cycle;        // per core, advanced by tick()
+        uint64_t servedAt;                  // cycle of the access the shared levels work on; the
+                                            // DRAM writes it causes arrive then
+        std::vector<std::ostream*> out;     // debug log per core
+        std::ostream *log;                  // debug log of the core the shared levels work for
+
+        // The shared levels and the DRAM log to this core's stream until told otherwise
+        void logTo(int core);
+
+        // Hands a completed access to the profiler and the trace recorder
+        void observe(int core, uint32_t pc, uint32_t address, bool mem_write, bool instruction);
+
+        // Queues e for the next sync() when there is a quantum, else applies it right away
+        void post(MemoryEvent e);
+        void apply(const MemoryEvent &e);
+
+        // An L1 missed: starts the miss now, or has it wait for the next sync
+        void requestMiss(Cache &l1, int core, uint32_t address, bool exclusive, bool allocate, bool instruction);
+
+        // At a sync: true, with the miss in m, if this L1's miss pays off within the next
+        // quantum (a DRAM read is only waited for once the core is parked)
+        bool fillDue(Cache &l1, bool instruction, MemoryEvent &m);
+
+        // True if bringing in this line could take away a line a sync placed in an L1 that has
+        // not been used yet
+        bool disturbs(uint32_t address);
+        // True if either line can push the other out: the same line (snooped away), or lines
+        // sharing a set in a shared level (evicted there, and with it from the L1s)
+        bool conflicts(uint32_t a, uint32_t b);
+
+        // access() for any width; writes only change the bytes in byte_mask
+        bool serve(int core, uint32_t address, uint32_t &read_data, uint32_t write_data, uint32_t byte_mask, bool mem_read, bool mem_write);
+
+        // After a core wrote a word into its L1: other reservations on the line break, and a
+        // write-through L1 passes the word on
+        void wrote(int core, uint32_t address);
+
+        // Write into a line the current access already paid for
+        void writeWord(int core, uint32_t address, uint32_t write_data, uint32_t byte_mask);
+
+        // Instruction fetch through a split L1I, with its own miss state
+        bool serveFetch(int core, uint32_t pc, uint32_t &instruction);
+
+        // An sc that fails after it missed still waits for its line and takes it, so a line
+        // held for this core is never left waiting for a retry that does not come. Returns
+        // false while the miss is being paid off.
+        bool finishMiss(int core);
+
+        // True while an L1 is paying off its miss, or waiting for DRAM to return the line
+        bool busy(Cache &l1, int core);
+
+        // Starts an L1 miss detected at cycle now: the stall missLatency() gives, or with DRAM,
+        // the time to reach the controller followed by a DRAM read of the line
+        void startMiss(Cache &l1, int core, uint32_t address, bool exclusive, bool allocate, bool instruction, uint64_t now);
+
+        // Cycles a core stalls to get this line (exclusive for writes) into its L1; an L1I
+        // only gets lines from the shared levels. memory tells whether no cache had it.
+        int missLatency(int core, uint32_t address, bool exclusive, bool instruction, bool &memory);
+
+        // The other L1s give up (exclusive) or share the line, writing back a MODIFIED copy;
+        // shared tells whether anyone kept a copy
+        void snoop(int core, uint32_t address, bool exclusive, bool &shared);
+
+        // Bring a line into a core's L1 once its miss is paid off
+        void fill(int core, uint32_t address, bool exclusive);
+
+        // Same for a core's L1I
+        void fillInstruction(int core, uint32_t address);
+
+        // Gets the block of data.size() words holding address from shared level lvl or further
+        // out, allocating it in each level passed that is not exclusive. Returns true if the
+        // block is dirty, which only happens when an exclusive level hands up a dirty line.
+        bool fetchBlock(int lvl, uint32_t address, std::vector<uint32_t> &data);
+
+        // Place a line in shared level lvl, evicting whatever it replaces
+        void insert(int lvl, uint32_t address, const std::vector<uint32_t> &data, bool dirty);
+
+        // A line leaves level lvl: an inclusive level takes it out of every level above first,
+        // then an exclusive next level keeps it, or a dirty one is written further out
+        void evict(int lvl, CacheLine &victim);
+
+        // Takes the lines of an inclusive victim out of one cache above it, merging dirty data
+        void backInvalidate(Cache &cache, CacheLine &victim);
+
+        // Write words into the first level from lvl outward that holds them, passing through
+        // write-through levels; memory takes whatever no cache holds
+        void writeBelow(int lvl, uint32_t address, const uint32_t *data, int words);
+
+        // A store that missed a no-write-allocate L1 is performed further out
+        void writeAround(int core, uint32_t address, uint32_t word, uint32_t byte_mask);
+
+        // A write by `core` clears every other core's reservation on that line
+        void breakLinks(int core, uint32_t address);
+
+        uint32_t lineMask() {
+            return ~(uint32_t)(config[0].lineSize-1);
+        }
     public:
         Memory() {
             mem.resize(2097152, 0);
             opt_level = 0;
+            quantum = 0;
+            profiler = NULL;
+            tracer = NULL;
+            log = &std::cout;
+            servedAt = 0;
+            config = defaultHierarchy();
+            setNumCores(1);
         }
         void setOptLevel(int level) {
             opt_level = level;
         }
+        void setProfiler(StackDistanceProfiler *p) {
+            profiler = p;
+        }
+        void setTracer(TraceWriter *t) {
+            tracer = t;
+        }
+        // Misses that go all the way out are timed by this DRAM instead of the last level's penalty
+        void setDRAM(const DRAMConfig &c) {
+            dram.configure(c);
+        }
+        // Cores run in separate host threads and call sync() every `cycles` cycles (0: they
+        // share one thread, or there is just one core)
+        void setQuantum(uint64_t cycles) {
+            quantum = cycles;
+        }
+        // Applies what every core queued since the last sync, with all of them stopped
+        void sync();
+        // With a quantum: true while the core can do nothing before the next sync. It stops
+        // there instead of spending the rest of the quantum on stalled cycles, so a miss costs
+        // the same whatever the quantum. A core holding a placed line never parks, since other
+        // cores' fills may wait for it to use the line.
+        bool parked(int core) {
+            uint32_t held;
+            return !level[0][core].holding(held) && (icache.empty() || !icache[core].holding(held)) &&
+                   (level[0][core].waitingForSync() || (!icache.empty() && icache[core].waitingForSync()));
+        }
+        // One cycle of this core has passed; events and DRAM timing need to know
+        void tick(int core) {
+            cycle[core]++;
+        }
+        // Debug output of this core's L1s, and of the shared levels while they serve it
+        void setOutput(int core, std::ostream *o);
+        // Rebuilds the caches (empty) from a hierarchy that passed checkHierarchy()
+        void setHierarchy(const std::vector<CacheConfig> &levels) {
+            config = levels;
+            setNumCores(level.empty() ? 1 : level[0].size());
+        }
+        // one private first-level cache (or L1I and L1D pair) per core, all sharing the deeper
+        // levels and main memory
+        void setNumCores(int num_cores) {
+            level.assign(config.size(), std::vector<Cache>());
+            icache.clear();
+            for (int l = 0; l < (int)config.size(); l++) {
+                const CacheConfig &c = config[l];
+                for (int i = 0; i < (l ? 1 : num_cores); i++) {
+                    std::string suffix = (l == 0 && num_cores > 1) ? "(" + std::to_string(i) + ")" : "";
+                    if (c.split) {
+                        icache.push_back(Cache(c.name + "I" + suffix, c.size, c.assoc, c.penalty, c.lineSize));
+                        level[l].push_back(Cache(c.name + "D" + suffix, c.size, c.assoc, c.penalty, c.lineSize));
+                    } else {
+                        level[l].push_back(Cache(c.name + suffix, c.size, c.assoc, c.penalty, c.lineSize));
+                    }
+                }
+            }
+            linkAddress.assign(num_cores, 0);
+            linkValid.assign(num_cores, false);
+            cycle.assign(num_cores, 0);
+            out.assign(num_cores, &std::cout);
+            pending.assign(num_cores, std::vector<MemoryEvent>());
+        }
         // address is the adress which needs to be read or written from
         // read_data the variable into which data is read, it is passed by reference
         // write_data is the data which is written into the memory address provided
         // mem_read specifies whether memory should be read or not
         // mem_write specifies whether memory whould be written to or not
+        // core selects the private L1 the access goes through
+        // pc is the instruction making the access, only used for tracing
         // returns false if there is a cache miss (O1 and above) 
         // -- currently follows stall-on-miss model, so call every cycle until you see a hit
-        bool access(uint32_t address, uint32_t &read_data, uint32_t write_data, bool mem_read, bool mem_write);
+        bool access(uint32_t address, uint32_t &read_data, uint32_t write_data, bool mem_read, bool mem_write, int core = 0, uint32_t pc = 0);
+
+        // Store of the bytes of write_data selected by byte_mask (0xff for sb, 0xffff for sh),
+        // without reading the word first
+        bool write(uint32_t address, uint32_t write_data, uint32_t byte_mask, int core = 0, uint32_t pc = 0);
+
+        // Write-combined store of one line: every word with a non-zero byte mask goes in with a
+        // single access, which misses (and stalls) at most once
+        bool writeLine(uint32_t address, const std::vector<uint32_t> &data, const std::vector<uint32_t> &mask, int core = 0, uint32_t pc = 0);
+
+        // Line size of the first-level caches
+        int getLineSize() {
+            return config[0].lineSize;
+        }
+
+        // True if accesses go through the caches (O1 and above)
+        bool cached() {
+            return opt_level > 0;
+        }
+
+        // True if fetches go through their own L1I, so they never compete with data accesses
+        bool splitL1() {
+            return opt_level > 0 && !icache.empty();
+        }
+
+        // Instruction fetch: a read of the word at pc, traced as an instruction reference; it
+        // goes through the core's L1I if the first level is split, else through the shared L1
+        bool fetch(uint32_t pc, uint32_t &instruction, int core = 0);
+
+        // ll: a read that also places a reservation on the line for this core
+        bool loadLinked(uint32_t address, uint32_t &read_data, int core = 0, uint32_t pc = 0);
+
+        // sc: returns false while the store waits on a miss; once it returns true,
+        // success tells whether the reservation still held and the word was written
+        bool storeConditional(uint32_t address, uint32_t write_data, bool &success, int core = 0, uint32_t pc = 0);
+
+        // Accesses and misses of every cache
+        void printStats(std::ostream &out);
+
+        // Row buffer statistics and read latency of the DRAM, if there is one
+        void printDRAMStats(std::ostream &out);
 
         // given a starting address and number of words from that starting address
         // this function prints int values at the memory
-        void print(uint32_t address, int num_words) {
+        void print(uint32_t address, int num_words, std::ostream &os = std::cout) {
             for (uint32_t i = address; i < address+num_words; ++i) {
-                std::cout<< "MEM[" << std::hex << i << "]: " << mem[i] << std::dec << "\n";
+                os<< "MEM[" << std::hex << i << "]: " << mem[i] << std::dec << "\n";
             }
         }
 };
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "multicore.h"
+using namespace std;
+
+uint64_t run_multicore(Memory &memory, vector<Processor*> &cores, uint32_t end_pc, uint64_t quantum) {
+    int num_cores = cores.size();
+    vector<stringstream> logs(num_cores);
+    vector<uint64_t> num_cycles(num_cores, 0);
+    bool done = false;
+    QuantumBarrier barrier(num_cores);
+
+    // One cycle of core i; false once it is done
+    auto step = [&](int i) {
+        Processor *core = cores[i];
+        if (core->getPC() > end_pc) {
+            return false;
+        }
+        core->advance();
+        logs[i] << "\nCORE " << i << " CYCLE " << num_cycles[i] << "\n";
+        core->printRegFile();
+        num_cycles[i]++;
+        return true;
+    };
+
+    // Runs once per quantum with every core parked at the barrier
+    auto release = [&]() {
+        memory.sync();
+        done = true;
+        for (int i = 0; i < num_cores; i++) {
+            cout << logs[i].str();
+            logs[i].str("");
+            done = done && cores[i]->getPC() > end_pc;
+        }
+    };
+
+    // Every core runs up to the same cycle each quantum. One that parks waiting for the sync
+    // is left behind there and catches up in the next quantum.
+    auto run_core = [&](int i) {
+        for (uint64_t end = quantum; ; end += quantum) {
+            while (num_cycles[i] < end && !memory.parked(i)) {
+                if (!step(i)) {
+                    break;
+                }
+            }
+            barrier.wait(release);
+            if (done) {
+                break;
+            }
+        }
+    };
+
+    for (int i = 0; i < num_cores; i++) {
+        cores[i]->setOutput(&logs[i]);
+    }
+    if (memory.cached()) {
+        memory.setQuantum(quantum);
+        vector<thread> threads;
+        for (int i = 0; i < num_cores; i++) {
+            threads.push_back(thread(run_core, i));
+        }
+        for (thread &t : threads) {
+            t.join();
+        }
+        memory.setQuantum(0);
+    } else {
+        while (!done) {
+            for (uint64_t q = 0; q < quantum; q++) {
+                for (int i = 0; i < num_cores; i++) {
+                    step(i);
+                }
+            }
+            release();
+        }
+    }
+    for (int i = 0; i < num_cores; i++) {
+        cores[i]->setOutput(&cout);
+    }
+
+    uint64_t max_cycles = 0;
+    for (int i = 0; i < num_cores; i++) {
+        max_cycles = max(max_cycles, num_cycles[i]);
+    }
+    return max_cycles;
+}
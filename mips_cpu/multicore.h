@@ -0,0 +1,48 @@
+#ifndef MULTICORE
+#define MULTICORE
+#include <vector>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include "processor.h"
+
+// Cores are simulated in host threads that run `quantum` cycles on their own and then
+// meet here. The last thread to arrive runs the release step (syncing the memory and
+// flushing the per-core logs in core order) before everyone moves on to the next quantum.
+class QuantumBarrier {
+    private:
+        std::mutex lock;
+        std::condition_variable released;
+        int num_threads;
+        int waiting;
+        uint64_t generation;
+    public:
+        QuantumBarrier(int n) {
+            num_threads = n;
+            waiting = 0;
+            generation = 0;
+        }
+
+        template <typename F>
+        void wait(F release) {
+            std::unique_lock<std::mutex> guard(lock);
+            uint64_t gen = generation;
+            if (++waiting == num_threads) {
+                release();
+                waiting = 0;
+                generation++;
+                released.notify_all();
+                return;
+            }
+            released.wait(guard, [&] { return generation != gen; });
+        }
+};
+
+// Runs every core until its PC passes end_pc, printing each core's register file every
+// cycle, and returns the cycle count of the slowest core. With caches each core gets its
+// own host thread; the memory queues what they do to each other and applies it at every
+// barrier in a fixed order, so a run always gives the same result. Without caches every
+// access goes straight to memory, so the cores take turns cycle by cycle on one thread.
+uint64_t run_multicore(Memory &memory, std::vector<Processor*> &cores, uint32_t end_pc, uint64_t quantum);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef PIPELINE
+#define PIPELINE
+#include <cstdint>
+#include "control.h"
+#include "jumppredictor.h"
+
+// Pipeline registers of the five-stage processor
+// A latch with valid == 0 holds a bubble
+
+struct IF_ID {
+    bool valid;
+    uint32_t pc;
+    uint32_t instruction;
+    uint32_t predicted_pc;   // where fetch went after this instruction
+    PredictorCheckpoint checkpoint;
+    bool decoded;            // streamed from the loop buffer, control already decoded
+    control_t control;
+};
+
+struct ID_EX {
+    bool valid;
+    uint32_t pc;
+    control_t control;
+    int opcode;
+    int rs;
+    int rt;
+    int shamt;
+    int funct;
+    uint32_t imm;            // already sign or zero extended
+    uint32_t addr;           // j/jal target field
+    uint32_t read_data_1;
+    uint32_t read_data_2;
+    int write_reg;
+    uint32_t instruction;
+    uint32_t predicted_pc;
+    PredictorCheckpoint checkpoint;
+    bool resolved;           // branch or jump already resolved in ID
+};
+
+struct EX_MEM {
+    bool valid;
+    uint32_t pc;
+    control_t control;
+    uint32_t alu_result;     // also carries the return address for jal
+    uint32_t write_data;     // R[rt] for stores, after forwarding
+    int write_reg;
+};
+
+struct MEM_WB {
+    bool valid;
+    uint32_t pc;
+    control_t control;
+    uint32_t alu_result;
+    uint32_t read_data_mem;  // loaded word, or the success flag of sc
+    int write_reg;
+};
+
+#endif
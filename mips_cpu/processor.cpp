@@ -26,13 +26,33 @@ void Processor::initialize(int level) {
                .byte = 0,
                .ALU_src = 0,
                .reg_write = 0,
-               .zero_extend = 0};
+               .zero_extend = 0,
+               .linked = 0,
+               .mult_div = 0};
    
     opt_level = level;
     // Optimization level-specific initialization
+    if_id.valid = false;
+    id_ex.valid = false;
+    ex_mem.valid = false;
+    mem_wb.valid = false;
+}
+
+uint32_t Processor::getPC() {
+    if (opt_level == 0) {
+        return regfile.pc;
+    }
+    // Oldest instruction that has not written back yet, or whose store is still buffered
+    if (!storeBuffer.empty()) return storeBuffer.oldestPC();
+    if (mem_wb.valid) return mem_wb.pc;
+    if (ex_mem.valid) return ex_mem.pc;
+    if (id_ex.valid) return id_ex.pc;
+    if (if_id.valid) return if_id.pc;
+    return regfile.pc;
 }
 
 void Processor::advance() {
+    memory->tick(core_id);
     switch (opt_level) {
         case 0: single_cycle_processor_advance();
                 break;
@@ -46,14 +66,15 @@ void Processor::advance() {
 void Processor::single_cycle_processor_advance() {
     // fetch
     uint32_t instruction;
-    memory->access(regfile.pc, instruction, 0, 1, 0);
-    DEBUG(cout << "\nPC: 0x" << std::hex << regfile.pc << std::dec << "\n");
+    uint32_t pc = regfile.pc;
+    memory->fetch(pc, instruction, core_id);
+    DEBUG(*out << "\nPC: 0x" << std::hex << regfile.pc << std::dec << "\n");
     // increment pc
     regfile.pc += 4;
     
     // decode into contol signals
     control.decode(instruction);
-    DEBUG(control.print());
+    DEBUG(control.print(*out));
 
     // extract rs, rt, rd, imm, funct 
     int opcode = (instruction >> 26) & 0x3f;
@@ -72,7 +93,9 @@ void Processor::single_cycle_processor_advance() {
     regfile.access(rs, rt, read_data_1, read_data_2, 0, 0, 0);
     
     // Execution 
-    alu.generate_control_inputs(control.ALU_op, funct, opcode);
+    if (!alu.generate_control_inputs(control.ALU_op, funct, opcode)) {
+        *out << "Unknown instruction 0x" << std::hex << instruction << " at pc 0x" << pc << std::dec << ", executed as add\n";
+    }
    
     // Sign Extend Or Zero Extend the immediate
     // Using Arithmetic right shift in order to replicate 1 
@@ -86,36 +109,385 @@ void Processor::single_cycle_processor_advance() {
     uint32_t alu_zero = 0;
 
     uint32_t alu_result = alu.execute(operand_1, operand_2, alu_zero);
+    // HI/LO instructions complete at once here, and mfhi, mflo take HI or LO as their result
+    if (control.mult_div) {
+        alu_result = multDiv.execute(funct, read_data_1, read_data_2);
+    }
     
     
     uint32_t read_data_mem = 0;
-    uint32_t write_data_mem = 0;
+    // sb and sh only touch the low byte or halfword of the word
+    uint32_t width = control.halfword ? 0xffff : control.byte ? 0xff : 0xffffffff;
 
     // Memory
-    // First read no matter whether it is a load or a store
-    memory->access(alu_result, read_data_mem, 0, control.mem_read | control.mem_write, 0);
-    // Stores: sb or sh mask and preserve original leftmost bits
-    write_data_mem = control.halfword ? (read_data_mem & 0xffff0000) | (read_data_2 & 0xffff) : 
-                    control.byte ? (read_data_mem & 0xffffff00) | (read_data_2 & 0xff): read_data_2;
-    // Write to memory only if mem_write is 1, i.e store
-    memory->access(alu_result, read_data_mem, write_data_mem, control.mem_read, control.mem_write);
+    if (control.linked) {
+        // ll places a reservation, sc only stores (and reads back 1) if it still holds
+        bool success = false;
+        if (control.mem_write) {
+            memory->storeConditional(alu_result, read_data_2, success, core_id, pc);
+            read_data_mem = success;
+        } else {
+            memory->loadLinked(alu_result, read_data_mem, core_id, pc);
+        }
+    } else if (control.mem_write) {
+        // Stores: sb or sh preserve the rest of the word
+        memory->write(alu_result, read_data_2, width, core_id, pc);
+    } else {
+        memory->access(alu_result, read_data_mem, 0, control.mem_read, 0, core_id, pc);
+    }
     // Loads: lbu or lhu modify read data by masking
-    read_data_mem &= control.halfword ? 0xffff : control.byte ? 0xff : 0xffffffff;
+    read_data_mem &= width;
 
     int write_reg = control.link ? 31 : control.reg_dest ? rd : rt;
 
-    uint32_t write_data = control.link ? regfile.pc+8 : control.mem_to_reg ? read_data_mem : alu_result;  
+    // pc already points past the jal, so the return address skips the delay slot
+    uint32_t write_data = control.link ? regfile.pc+4 : control.mem_to_reg ? read_data_mem : alu_result;  
 
     // Write Back
     regfile.access(0, 0, read_data_2, read_data_2, write_reg, control.reg_write, write_data);
     
     // Update PC
     regfile.pc += (control.branch && !control.bne && alu_zero) || (control.bne && !alu_zero) ? imm << 2 : 0; 
-    regfile.pc = control.jump_reg ? read_data_1 : control.jump ? (regfile.pc & 0xf0000000) & (addr << 2): regfile.pc;
+    regfile.pc = control.jump_reg ? read_data_1 : control.jump ? (regfile.pc & 0xf0000000) | (addr << 2): regfile.pc;
 }
 
 void Processor::pipelined_processor_advance() {
-    // pipelined processor logic goes here
-    // does nothing currently -- if you call it from the cmd line, you'll run into an infinite loop
-    // might be helpful to implement stages in a separate module
+    DEBUG(*out << "\nIF: 0x" << std::hex << regfile.pc
+               << " ID: " << (if_id.valid ? if_id.pc : 0) << (if_id.valid ? "" : "(bubble)")
+               << " EX: " << (id_ex.valid ? id_ex.pc : 0) << (id_ex.valid ? "" : "(bubble)")
+               << " MEM: " << (ex_mem.valid ? ex_mem.pc : 0) << (ex_mem.valid ? "" : "(bubble)")
+               << " WB: " << (mem_wb.valid ? mem_wb.pc : 0) << (mem_wb.valid ? "" : "(bubble)")
+               << std::dec << "\n");
+
+    // Stages run back to front, so each one consumes its input latch before the
+    // previous stage overwrites it
+    multDiv.tick();
+    MEM_WB retiring = mem_wb;
+    writeback_stage();
+
+    // Buffered stores drain whenever MEM leaves the L1D port free. With a unified L1,
+    // IF shares that port and comes last. ll and sc wait for the buffer to empty.
+    bool used_port = false;
+    bool fence = ex_mem.valid && ex_mem.control.linked;
+    bool mem_stall = memory_stage(used_port);
+    used_port |= storeBuffer.drain(!used_port, fence);
+
+    bool redirect = false;
+    uint32_t target = 0;
+    if (!mem_stall) {
+        execute_stage(retiring, redirect, target);
+    } else if (id_ex.valid) {
+        // Held in EX: pick up results that retire while we wait, they won't be forwardable later
+        id_ex.read_data_1 = forward(id_ex.rs, id_ex.read_data_1, retiring);
+        id_ex.read_data_2 = forward(id_ex.rt, id_ex.read_data_2, retiring);
+    }
+
+    bool id_stall = decode_stage(mem_stall, redirect, target);
+    fetch_stage(id_stall, redirect, used_port && !memory->splitL1(), target);
+}
+
+void Processor::writeback_stage() {
+    if (!mem_wb.valid) {
+        return;
+    }
+    uint32_t dummy;
+    uint32_t write_data = mem_wb.control.mem_to_reg ? mem_wb.read_data_mem : mem_wb.alu_result;
+    regfile.access(0, 0, dummy, dummy, mem_wb.write_reg, mem_wb.control.reg_write, write_data);
+}
+
+// Returns true if the instruction in MEM is waiting on the memory system
+bool Processor::memory_stage(bool &used_port) {
+    if (!ex_mem.valid) {
+        mem_wb.valid = false;
+        return false;
+    }
+    control_t &c = ex_mem.control;
+    uint32_t read_data_mem = 0;
+
+    if (c.mem_read || c.mem_write) {
+        bool done;
+        // sb and sh only touch the low byte or halfword of the word
+        uint32_t width = c.halfword ? 0xffff : c.byte ? 0xff : 0xffffffff;
+        used_port = true;
+        if (c.linked && !storeBuffer.empty()) {
+            used_port = false;
+            done = false;
+        } else if (c.linked && c.mem_write) {
+            bool success = false;
+            done = memory->storeConditional(ex_mem.alu_result, ex_mem.write_data, success, core_id, ex_mem.pc);
+            read_data_mem = success;
+        } else if (c.linked) {
+            done = memory->loadLinked(ex_mem.alu_result, read_data_mem, core_id, ex_mem.pc);
+        } else if (c.mem_write && storeBuffer.enabled()) {
+            // Retire into the store buffer; only a full buffer holds the store here
+            used_port = false;
+            done = storeBuffer.insert(ex_mem.alu_result, ex_mem.write_data, width, ex_mem.pc);
+        } else if (c.mem_write) {
+            // Stores: sb or sh preserve the rest of the word
+            done = memory->write(ex_mem.alu_result, ex_mem.write_data, width, core_id, ex_mem.pc);
+        } else if (storeBuffer.forward(ex_mem.alu_result, width, read_data_mem)) {
+            // Every byte the load wants is still in the store buffer
+            used_port = false;
+            done = true;
+        } else {
+            done = memory->access(ex_mem.alu_result, read_data_mem, 0, 1, 0, core_id, ex_mem.pc);
+            if (done) {
+                storeBuffer.overlay(ex_mem.alu_result, width, read_data_mem);
+            }
+        }
+        // Loads: lbu or lhu modify read data by masking
+        read_data_mem &= width;
+        if (!done) {
+            mem_wb.valid = false;
+            return true;
+        }
+    }
+
+    mem_wb.valid = true;
+    mem_wb.pc = ex_mem.pc;
+    mem_wb.control = c;
+    mem_wb.alu_result = ex_mem.alu_result;
+    mem_wb.read_data_mem = read_data_mem;
+    mem_wb.write_reg = ex_mem.write_reg;
+    return false;
+}
+
+// Newest value of a source register: the ALU result in EX/MEM, then whatever is retiring this cycle
+uint32_t Processor::forward(int reg, uint32_t value, const MEM_WB &retiring) {
+    if (!reg) {
+        return value;
+    }
+    if (ex_mem.valid && ex_mem.control.reg_write && !ex_mem.control.mem_to_reg && ex_mem.write_reg == reg) {
+        return ex_mem.alu_result;
+    }
+    if (retiring.valid && retiring.control.reg_write && retiring.write_reg == reg) {
+        return retiring.control.mem_to_reg ? retiring.read_data_mem : retiring.alu_result;
+    }
+    return value;
+}
+
+// Branches and jumps resolve here, so a taken one squashes the two instructions behind it
+void Processor::execute_stage(const MEM_WB &retiring, bool &redirect, uint32_t &target) {
+    if (!id_ex.valid) {
+        ex_mem.valid = false;
+        return;
+    }
+    control_t &c = id_ex.control;
+    uint32_t read_data_1 = forward(id_ex.rs, id_ex.read_data_1, retiring);
+    uint32_t read_data_2 = forward(id_ex.rt, id_ex.read_data_2, retiring);
+
+    if (!alu.generate_control_inputs(c.ALU_op, id_ex.funct, id_ex.opcode)) {
+        *out << "Unknown instruction 0x" << std::hex << id_ex.instruction << " at pc 0x" << id_ex.pc << std::dec << ", executed as add\n";
+    }
+    uint32_t operand_1 = c.shift ? id_ex.shamt : read_data_1;
+    uint32_t operand_2 = c.ALU_src ? id_ex.imm : read_data_2;
+    uint32_t alu_zero = 0;
+    uint32_t alu_result = alu.execute(operand_1, operand_2, alu_zero);
+    // mult and div are handed to their unit and move on; ID made sure mfhi and mflo find HI/LO ready
+    if (c.mult_div) {
+        alu_result = multDiv.execute(id_ex.funct, read_data_1, read_data_2);
+    }
+
+    if ((c.branch && !c.bne && alu_zero) || (c.bne && !alu_zero)) {
+        redirect = true;
+        target = id_ex.pc + 4 + (id_ex.imm << 2);
+    } else if (c.jump) {
+        redirect = true;
+        target = c.jump_reg ? read_data_1 : ((id_ex.pc + 4) & 0xf0000000) | (id_ex.addr << 2);
+    }
+    if (id_ex.resolved) {
+        // ID already sent fetch the right way
+        redirect = false;
+    } else if (jumpPredictor.enabled() || loopBuffer.enabled()) {
+        // Only a wrong guess at fetch squashes what came after
+        uint32_t next_pc = redirect ? target : id_ex.pc + 4;
+        redirect = resolveControl(id_ex.pc, id_ex.instruction, c, id_ex.checkpoint, id_ex.predicted_pc, next_pc);
+        target = next_pc;
+    }
+
+    ex_mem.valid = true;
+    ex_mem.pc = id_ex.pc;
+    ex_mem.control = c;
+    ex_mem.alu_result = c.link ? id_ex.pc + 8 : alu_result;
+    ex_mem.write_data = read_data_2;
+    ex_mem.write_reg = id_ex.write_reg;
+}
+
+bool Processor::resolveControl(uint32_t pc, uint32_t instruction, const control_t &c,
+                               const PredictorCheckpoint &checkpoint, uint32_t predicted_pc, uint32_t next_pc) {
+    if (jumpPredictor.enabled()) {
+        jumpPredictor.resolve(pc, instruction, checkpoint, predicted_pc, next_pc);
+    }
+    if (c.branch || c.jump) {
+        loopBuffer.resolve(pc, c.branch, next_pc);
+    }
+    DEBUG(if (next_pc != predicted_pc) *out << "Mispredicted 0x" << std::hex << pc << ": redirecting to 0x" << next_pc << std::dec << "\n");
+    return next_pc != predicted_pc;
+}
+
+// At the time ID runs, EX/MEM holds what EX finished this cycle and MEM/WB what MEM finished,
+// so only an ALU result in MEM/WB can be forwarded
+bool Processor::notReadyForID(int reg) {
+    if (!reg) {
+        return false;
+    }
+    if (ex_mem.valid && ex_mem.control.reg_write && ex_mem.write_reg == reg) {
+        return true;
+    }
+    return mem_wb.valid && mem_wb.control.reg_write && mem_wb.control.mem_to_reg && mem_wb.write_reg == reg;
+}
+
+uint32_t Processor::forwardToID(int reg, uint32_t value) {
+    if (reg && mem_wb.valid && mem_wb.control.reg_write && mem_wb.write_reg == reg) {
+        return mem_wb.alu_result;
+    }
+    return value;
+}
+
+// Returns true if the instruction in IF/ID could not move on this cycle. A branch or jump
+// resolved here redirects fetch through redirect and target.
+bool Processor::decode_stage(bool stall, bool &redirect, uint32_t &target) {
+    if (redirect) {
+        id_ex.valid = false;
+        return false;
+    }
+    if (stall) {
+        return if_id.valid;
+    }
+    if (!if_id.valid) {
+        id_ex.valid = false;
+        return false;
+    }
+
+    uint32_t instruction = if_id.instruction;
+    control_t c;
+    if (if_id.decoded) {
+        c = if_id.control;
+    } else {
+        c.decode(instruction);
+    }
+    int rs = (instruction >> 21) & 0x1f;
+    int rt = (instruction >> 16) & 0x1f;
+
+    // Load-use: a loaded value reaches EX one cycle too late to be forwarded
+    bool uses_rs = !c.jump || c.jump_reg;
+    bool uses_rt = !((instruction >> 26) & 0x3f) || c.branch || c.mem_write;
+    if (ex_mem.valid && ex_mem.control.mem_to_reg && ex_mem.write_reg &&
+        ((uses_rs && ex_mem.write_reg == rs) || (uses_rt && ex_mem.write_reg == rt))) {
+        DEBUG(*out << "Load-use hazard at 0x" << std::hex << if_id.pc << std::dec << ": stalling\n");
+        id_ex.valid = false;
+        return true;
+    }
+    // Interlock on the multiplier and divider: a busy unit, or HI/LO not written yet
+    if (c.mult_div && multDiv.mustWait(instruction & 0x3f)) {
+        DEBUG(*out << "Multiply/divide unit not ready at 0x" << std::hex << if_id.pc << std::dec << ": stalling\n");
+        id_ex.valid = false;
+        return true;
+    }
+    // The early comparator needs both operands at the start of ID
+    bool early = early_branches && (c.branch || (c.jump && !c.jump_reg));
+    if (early && c.branch && (notReadyForID(rs) || notReadyForID(rt))) {
+        DEBUG(*out << "Branch operand not ready at 0x" << std::hex << if_id.pc << std::dec << ": stalling\n");
+        id_stalls++;
+        id_ex.valid = false;
+        return true;
+    }
+
+    id_ex.valid = true;
+    id_ex.pc = if_id.pc;
+    id_ex.control = c;
+    id_ex.opcode = (instruction >> 26) & 0x3f;
+    id_ex.rs = rs;
+    id_ex.rt = rt;
+    id_ex.shamt = (instruction >> 6) & 0x1f;
+    id_ex.funct = instruction & 0x3f;
+    // Sign Extend Or Zero Extend the immediate
+    uint32_t imm = instruction & 0xffff;
+    id_ex.imm = c.zero_extend ? imm : (imm >> 15) ? 0xffff0000 | imm : imm;
+    id_ex.addr = instruction & 0x3ffffff;
+    id_ex.instruction = instruction;
+    id_ex.predicted_pc = if_id.predicted_pc;
+    id_ex.checkpoint = if_id.checkpoint;
+    id_ex.resolved = false;
+    // Register file is written in the first half of the cycle and read in the second
+    regfile.access(rs, rt, id_ex.read_data_1, id_ex.read_data_2, 0, 0, 0);
+    id_ex.write_reg = c.link ? 31 : c.reg_dest ? (instruction >> 11) & 0x1f : rt;
+
+    if (early) {
+        // Equality comparator instead of the ALU's subtract; only one instruction is squashed
+        uint32_t a = forwardToID(rs, id_ex.read_data_1);
+        uint32_t b = forwardToID(rt, id_ex.read_data_2);
+        uint32_t next_pc = id_ex.pc + 4;
+        if (c.jump) {
+            next_pc = ((id_ex.pc + 4) & 0xf0000000) | (id_ex.addr << 2);
+        } else if ((a == b) != c.bne) {
+            next_pc = id_ex.pc + 4 + (id_ex.imm << 2);
+        }
+        redirect = resolveControl(id_ex.pc, instruction, c, id_ex.checkpoint, id_ex.predicted_pc, next_pc);
+        target = next_pc;
+        id_ex.predicted_pc = next_pc;
+        id_ex.resolved = true;
+        id_resolved++;
+        id_redirects += redirect;
+    }
+    return false;
+}
+
+void Processor::fetch_stage(bool stall, bool flush, bool port_busy, uint32_t target) {
+    if (flush) {
+        if_id.valid = false;
+        regfile.pc = target;
+        return;
+    }
+    if (stall) {
+        return;
+    }
+    uint32_t instruction;
+    if (loopBuffer.fetch(regfile.pc, instruction, if_id.control)) {
+        // A streamed loop needs neither the L1I nor the decoder
+        if_id.decoded = true;
+    } else if (port_busy || !memory->fetch(regfile.pc, instruction, core_id)) {
+        if_id.valid = false;
+        return;
+    } else {
+        if_id.decoded = false;
+        loopBuffer.capture(regfile.pc, instruction);
+    }
+    if_id.valid = true;
+    if_id.pc = regfile.pc;
+    if_id.instruction = instruction;
+    uint32_t next_pc = regfile.pc + 4;
+    if (jumpPredictor.enabled()) {
+        next_pc = jumpPredictor.predict(regfile.pc, instruction, if_id.checkpoint);
+    }
+    if (next_pc == regfile.pc + 4) {
+        next_pc = loopBuffer.predict(regfile.pc);
+    }
+    regfile.pc = next_pc;
+    if_id.predicted_pc = regfile.pc;
+}
+
+void Processor::printStats(std::ostream &out) {
+    if (storeBuffer.enabled()) {
+        out << "Core " << core_id << " ";
+        storeBuffer.printStats(out);
+    }
+    if (jumpPredictor.enabled()) {
+        out << "Core " << core_id << " ";
+        jumpPredictor.printStats(out);
+    }
+    if (loopBuffer.enabled()) {
+        out << "Core " << core_id << " ";
+        loopBuffer.printStats(out);
+    }
+    if (multDiv.used()) {
+        out << "Core " << core_id << " ";
+        multDiv.printStats(out);
+    }
+    if (early_branches) {
+        // Each redirect from ID squashes one instruction instead of two
+        out << "Core " << core_id << " Early branch resolution: " << id_resolved << " branches and jumps resolved in ID, "
+            << id_redirects << " redirects (" << id_redirects << " penalty cycles saved over EX), "
+            << id_stalls << " cycles stalled for operands, net " << (int64_t)(id_redirects - id_stalls) << " cycles\n";
+    }
 }
@@ -1,34 +1,115 @@
+#ifndef PROCESSOR
+#define PROCESSOR
 #include "memory.h"
 #include "regfile.h"
 #include "ALU.h"
 #include "control.h"
+#include "pipeline.h"
+#include "storebuffer.h"
+#include "jumppredictor.h"
+#include "loopbuffer.h"
+#include "funcunit.h"
 class Processor {
     private:
         int opt_level;
+        int core_id;
         ALU alu;
         control_t control;
         Memory *memory;
         Registers regfile;
+        std::ostream *out;
         // add other structures as needed
 
         // pipelined processor
+        IF_ID if_id;
+        ID_EX id_ex;
+        EX_MEM ex_mem;
+        MEM_WB mem_wb;
+        StoreBuffer storeBuffer;
+        JumpPredictor jumpPredictor;
+        LoopBuffer loopBuffer;
+        MultDivUnits multDiv;
+        bool early_branches;        // resolve beq, bne, j and jal in ID
+        uint64_t id_resolved;
+        uint64_t id_redirects;
+        uint64_t id_stalls;
 
         // add private functions
         void single_cycle_processor_advance();
         void pipelined_processor_advance();
+
+        // pipeline stages, called back to front once per cycle
+        void writeback_stage();
+        bool memory_stage(bool &used_port);
+        void execute_stage(const MEM_WB &retiring, bool &redirect, uint32_t &target);
+        bool decode_stage(bool stall, bool &redirect, uint32_t &target);
+        void fetch_stage(bool stall, bool flush, bool port_busy, uint32_t target);
+        uint32_t forward(int reg, uint32_t value, const MEM_WB &retiring);
+
+        // Early resolution: whether a register's newest value is still being computed or loaded
+        // when ID wants it, and the value forwarded into ID otherwise
+        bool notReadyForID(int reg);
+        uint32_t forwardToID(int reg, uint32_t value);
+
+        // A branch or jump at pc turned out to go to next_pc: trains the fetch-stage predictors
+        // and returns true if fetch went somewhere else
+        bool resolveControl(uint32_t pc, uint32_t instruction, const control_t &c,
+                            const PredictorCheckpoint &checkpoint, uint32_t predicted_pc, uint32_t next_pc);
  
     public:
-        Processor(Memory *mem) { regfile.pc = 0; memory = mem;}
+        // core selects this processor's private L1; each core starts at PC 0 with its id in $k0
+        Processor(Memory *mem, int core = 0) : storeBuffer(mem, core) {
+            regfile.pc = 0;
+            memory = mem;
+            core_id = core;
+            out = &std::cout;
+            early_branches = false;
+            id_resolved = id_redirects = id_stalls = 0;
+            uint32_t dummy;
+            regfile.access(0, 0, dummy, dummy, 26, core != 0, core);
+        }
 
         // Get PC
-        uint32_t getPC() { return regfile.pc; }
+        // In the pipelined processor, this is the PC of the oldest instruction still in flight
+        uint32_t getPC();
 
         // Prints the Register File
-        void printRegFile() { regfile.print(); }
+        void printRegFile() { regfile.print(*out); }
+
+        // Redirect the per-cycle log, and the debug output of this core's structures and L1s
+        // (multi-core runs buffer it per core)
+        void setOutput(std::ostream *o) {
+            out = o;
+            storeBuffer.setOutput(o);
+            loopBuffer.setOutput(o);
+            multDiv.setOutput(o);
+            memory->setOutput(core_id, o);
+        }
         
         // Initializes the processor appropriately based on the optimization level
         void initialize(int opt_level);
 
+        // Pipelined processor: retire stores into a buffer of this many lines (0 disables it)
+        void setStoreBuffer(int entries) { storeBuffer.setCapacity(entries); }
+
+        // Pipelined processor: predict jump targets at fetch with a return address stack and an
+        // indirect target cache of these sizes (both 0 disables it)
+        void setJumpPredictor(int ras_entries, int target_entries) { jumpPredictor.configure(ras_entries, target_entries); }
+
+        // Pipelined processor: stream loops of up to this many instructions from a loop buffer
+        // (0 disables it)
+        void setLoopBuffer(int entries) { loopBuffer.setCapacity(entries); }
+
+        // Pipelined processor: resolve beq, bne, j and jal in ID instead of EX
+        void setEarlyBranches(bool enable) { early_branches = enable; }
+
+        // Latency and pipelining of the multiplier and divider
+        void setUnits(const UnitConfig &config) { multDiv.configure(config); }
+
+        // Prints statistics of the optional structures that are enabled
+        void printStats(std::ostream &out);
+
         // Advances the processor to an appropriate state every cycle
         void advance(); 
 };
+#endif
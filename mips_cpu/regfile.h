@@ -44,9 +44,9 @@ class Registers {
         }
 
         // Prints the contents of all the registers
-        void print() {
+        void print(std::ostream &out = std::cout) {
             for(int i = 0; i < 32; ++i) {
-                std::cout << std::dec << "R[" << i << "]: " << R[i].value << "\n";
+                out << std::dec << "R[" << i << "]: " << R[i].value << "\n";
             }
         }
         // Prints the contents of the register specified by reg 
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <getopt.h>
+#include "memory.h"
+#include "stackdist.h"
+#include "trace.h"
+/* Trace-driven replay: feeds a recorded access stream straight into the memory system,
+   with no fetch/decode/execute, so cache changes can be regression-tested on their own. */
+using namespace std;
+
+void print_help()
+{
+    cout << "Required Options.\n"
+            "--trace <path-to-trace>              Trace recorded with processor --record-trace\n"
+            "Optional:\n"
+            "--help                               Print this help message\n"
+            "--cache-config <path>                Replay through this cache hierarchy instead of the default\n"
+            "--cache <name>,<key>=<value>,...     Change or add one cache level (see processor --help)\n"
+            "--dram[=<key>=<value>,...]           Time misses that reach memory with a banked DRAM model\n"
+            "                                     (see processor --help)\n"
+            "--stack-distance                     Also report LRU and OPT hit ratios for every cache\n"
+            "                                     geometry (sets x ways) from the same references\n"
+            "Hit/miss statistics and the cycles the memory system was busy go to stdout,\n"
+            "the replay rate to stderr, so two runs can be diffed. References are replayed one\n"
+            "at a time in trace order, so the counts can differ from the recording run's.\n";
+}
+
+int main(int argc, char *argv[]) {
+    static struct option long_options[] = {
+      {"trace", required_argument, 0, 't'},
+      {"stack-distance", no_argument, 0, 's'},
+      {"cache-config", required_argument, 0, 'C'},
+      {"cache", required_argument, 0, 'L'},
+      {"dram", optional_argument, 0, 'D'},
+      {"help", no_argument, 0, 'h'},
+      {0, 0, 0, 0}
+    };
+    int option_index = 0;
+    string tracePath;
+    bool stackDistance = false;
+    string cacheConfigPath;
+    vector<string> cacheSpecs;
+    bool useDRAM = false;
+    DRAMConfig dramConfig = defaultDRAM();
+    string error;
+
+    while (true) {
+      int c = getopt_long(argc, argv, "t:shC:L:D::", long_options, &option_index);
+      if (c == -1) {
+          break;
+      }
+      switch (c) {
+          default :
+          case 'h':
+              print_help();
+              exit(0);
+          case 't':
+              tracePath = optarg;
+              break;
+          case 's':
+              stackDistance = true;
+              break;
+          case 'C':
+              cacheConfigPath = optarg;
+              break;
+          case 'L':
+              cacheSpecs.push_back(optarg);
+              break;
+          case 'D':
+              useDRAM = true;
+              if (optarg && !applyDRAMSpec(dramConfig, optarg, error)) {
+                  cout << "Invalid DRAM: " << error << "\n";
+                  exit(1);
+              }
+              break;
+      }
+    }
+    if (tracePath.empty()) {
+        print_help();
+        exit(0);
+    }
+
+    TraceReader reader;
+    if (!reader.open(tracePath)) {
+        cout << "Failed to open trace: " << tracePath << "\n";
+        exit(1);
+    }
+
+    vector<CacheConfig> hierarchy;
+    if (!buildHierarchy(cacheConfigPath, cacheSpecs, hierarchy, error)) {
+        cout << "Invalid cache hierarchy: " << error << "\n";
+        exit(1);
+    }
+
+    // The cache hierarchy only exists from O1 up
+    Memory memory;
+    StackDistanceProfiler profiler;
+    int numCores = reader.getNumCores();
+    memory.setOptLevel(1);
+    memory.setHierarchy(hierarchy);
+    memory.setNumCores(numCores);
+    if (useDRAM) {
+        memory.setDRAM(dramConfig);
+    }
+    if (stackDistance) {
+        memory.setProfiler(&profiler);
+    }
+
+    TraceRecord r;
+    uint64_t references = 0;
+    uint64_t fetches = 0;
+    uint64_t num_cycles = 0;
+    auto start = chrono::steady_clock::now();
+    while (reader.read(r)) {
+        if (r.core >= numCores) {
+            cout << "Reference " << references << " is from core " << r.core << " of " << numCores << "\n";
+            exit(1);
+        }
+        // Values are not part of the trace, so stores write zeroes. Every try is one cycle.
+        uint32_t data;
+        memory.tick(r.core);
+        if (r.instruction) {
+            while (!memory.fetch(r.pc, data, r.core)) {
+                num_cycles++;
+                memory.tick(r.core);
+            }
+        } else {
+            while (!memory.access(r.address, data, 0, !r.write, r.write, r.core, r.pc)) {
+                num_cycles++;
+                memory.tick(r.core);
+            }
+        }
+        num_cycles++;
+        references++;
+        fetches += r.instruction;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Replayed " << references << " references (" << fetches << " instruction, "
+         << references-fetches << " data) from " << numCores << " core(s)\n";
+    cout << "Memory system busy for " << num_cycles << " cycles\n";
+    memory.printStats(cout);
+    memory.printDRAMStats(cout);
+    cerr << "Replay rate: " << (seconds > 0 ? references/seconds : 0) << " references/s\n";
+    if (stackDistance) {
+        profiler.report(cout);
+    }
+}
@@ -0,0 +1,125 @@
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <iomanip>
+#include <unordered_map>
+#include <algorithm>
+#include "memory.h"
+#include "stackdist.h"
+
+using namespace std;
+
+void StackDistanceProfiler::record(int core, uint32_t address, bool instruction) {
+    numCores = max(numCores, core+1);
+    (instruction ? fetches : data).push_back(address / CACHE_LINE_SIZE);
+}
+
+// One LRU stack per set, most recently used on top. Entries deeper than maxAssoc
+// can never hit in the geometries we report, so they are dropped.
+vector<uint64_t> StackDistanceProfiler::lruDistances(const vector<uint32_t> &trace, int num_sets) {
+    vector<uint64_t> hist(maxAssoc+1, 0);
+    vector<vector<uint32_t>> stacks(num_sets);
+
+    for (uint32_t lineAddr : trace) {
+        vector<uint32_t> &stack = stacks[lineAddr & (num_sets-1)];
+        int d = find(stack.begin(), stack.end(), lineAddr) - stack.begin();
+        hist[d < (int)stack.size() ? d : maxAssoc]++;
+
+        if (d == (int)stack.size()) {
+            stack.insert(stack.begin(), lineAddr);
+            if ((int)stack.size() > maxAssoc) {
+                stack.pop_back();
+            }
+        } else {
+            rotate(stack.begin(), stack.begin()+d, stack.begin()+d+1);
+        }
+    }
+    return hist;
+}
+
+// Same idea for OPT (Mattson's priority stack): the referenced line goes on top, and on
+// the way down to its old position every level keeps whichever of the carried line and
+// its own line is reused sooner. The top `a` entries are then exactly what an a-way OPT
+// cache would hold.
+vector<uint64_t> StackDistanceProfiler::optDistances(const vector<uint32_t> &trace, int num_sets, const vector<uint64_t> &next_use) {
+    vector<uint64_t> hist(maxAssoc+1, 0);
+    vector<vector<pair<uint64_t, uint32_t>>> stacks(num_sets);   // (next use, line)
+
+    for (uint64_t t = 0; t < trace.size(); t++) {
+        uint32_t lineAddr = trace[t];
+        vector<pair<uint64_t, uint32_t>> &stack = stacks[lineAddr & (num_sets-1)];
+        int d = 0;
+        while (d < (int)stack.size() && stack[d].second != lineAddr) {
+            d++;
+        }
+        hist[d < (int)stack.size() ? d : maxAssoc]++;
+
+        pair<uint64_t, uint32_t> top(next_use[t], lineAddr);
+        if (stack.empty()) {
+            stack.push_back(top);
+            continue;
+        }
+        if (d == 0) {
+            stack[0] = top;
+            continue;
+        }
+        pair<uint64_t, uint32_t> carry = stack[0];
+        stack[0] = top;
+        for (int i = 1; i < min(d, (int)stack.size()); i++) {
+            if (carry.first < stack[i].first) {
+                swap(carry, stack[i]);
+            }
+        }
+        if (d < (int)stack.size()) {
+            stack[d] = carry;
+        } else if ((int)stack.size() < maxAssoc) {
+            stack.push_back(carry);
+        }
+    }
+    return hist;
+}
+
+void StackDistanceProfiler::report(ostream &out) {
+    report(out, "instruction fetches", fetches);
+    report(out, "loads and stores", data);
+}
+
+void StackDistanceProfiler::report(ostream &out, const string &name, const vector<uint32_t> &trace) {
+    // Next reference time of every reference, for OPT
+    vector<uint64_t> next_use(trace.size());
+    unordered_map<uint32_t, uint64_t> seen;
+    for (uint64_t t = trace.size(); t-- > 0;) {
+        auto it = seen.find(trace[t]);
+        next_use[t] = (it == seen.end()) ? UINT64_MAX : it->second;
+        seen[trace[t]] = t;
+    }
+
+    out << "\nStack distance profile of " << name;
+    if (numCores > 1) {
+        out << " (all " << numCores << " cores combined)";
+    }
+    out << ": " << trace.size() << " references to " << seen.size() << " distinct "
+        << CACHE_LINE_SIZE << "B lines\n";
+    if (trace.empty()) {
+        return;
+    }
+    out << setw(8) << "sets" << setw(8) << "assoc" << setw(12) << "capacity" << setw(12) << "LRU hit%" << setw(12) << "OPT hit%" << "\n";
+    out << fixed << setprecision(2);
+    for (int k = 0; k <= maxSetsLog2; k++) {
+        int num_sets = 1 << k;
+        vector<uint64_t> lru = lruDistances(trace, num_sets);
+        vector<uint64_t> opt = optDistances(trace, num_sets, next_use);
+        uint64_t lru_hits = 0;
+        uint64_t opt_hits = 0;
+        for (int a = 1, d = 0; a <= maxAssoc; a *= 2) {
+            // a distance below the associativity is a hit
+            for (; d < a; d++) {
+                lru_hits += lru[d];
+                opt_hits += opt[d];
+            }
+            out << setw(8) << num_sets << setw(8) << a << setw(12) << num_sets*a*CACHE_LINE_SIZE
+                << setw(12) << 100.0*lru_hits/trace.size() << setw(12) << 100.0*opt_hits/trace.size() << "\n";
+        }
+    }
+    out << defaultfloat;
+}
@@ -0,0 +1,42 @@
+#ifndef STACKDIST
+#define STACKDIST
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Collects the line-address streams that reach the L1I and the L1D and, from that single
+// run, derives the hit ratio of every cache geometry with CACHE_LINE_SIZE lines for each of
+// them: LRU stack distances per set count (Mattson), plus the same for Belady's OPT as a
+// lower bound on misses. The references of all cores go into the same two streams.
+class StackDistanceProfiler {
+    private:
+        std::vector<uint32_t> fetches;  // line addresses in reference order
+        std::vector<uint32_t> data;
+        int numCores;                   // highest core id seen, plus one
+        int maxSetsLog2;                // set counts 1, 2, 4 ... 2^maxSetsLog2
+        int maxAssoc;                   // associativities 1, 2, 4 ... maxAssoc
+
+        // Histogram of stack distances (index maxAssoc collects misses at every
+        // associativity, cold misses included) for one set count
+        std::vector<uint64_t> lruDistances(const std::vector<uint32_t> &trace, int num_sets);
+        std::vector<uint64_t> optDistances(const std::vector<uint32_t> &trace, int num_sets, const std::vector<uint64_t> &next_use);
+
+        // The table for one stream
+        void report(std::ostream &out, const std::string &name, const std::vector<uint32_t> &trace);
+    public:
+        StackDistanceProfiler(int max_sets_log2 = 12, int max_assoc = 16) {
+            numCores = 1;
+            maxSetsLog2 = max_sets_log2;
+            maxAssoc = max_assoc;
+        }
+
+        // Called for every access the memory system completes
+        void record(int core, uint32_t address, bool instruction);
+
+        // Prints LRU and OPT hit ratios for every sets x associativity point, instruction
+        // fetches first, then loads and stores
+        void report(std::ostream &out);
+};
+
+#endif
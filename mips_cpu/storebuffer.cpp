@@ -0,0 +1,80 @@
+#include <cstdint>
+#include <iostream>
+#include "storebuffer.h"
+
+#ifdef ENABLE_DEBUG
+#define DEBUG(x) x
+#else
+#define DEBUG(x)
+#endif
+
+using namespace std;
+
+uint32_t StoreBuffer::gather(uint32_t address, uint32_t &value) {
+    uint32_t lineAddr = address & ~(uint32_t)(memory->getLineSize()-1);
+    uint32_t found = 0;
+    for (StoreBufferEntry &e : entries) {
+        if (e.lineAddress == lineAddr) {
+            int w = (address - lineAddr)/4;
+            value = (value & ~e.mask[w]) | (e.data[w] & e.mask[w]);
+            found |= e.mask[w];
+        }
+    }
+    return found;
+}
+
+bool StoreBuffer::insert(uint32_t address, uint32_t data, uint32_t byte_mask, uint32_t pc) {
+    uint32_t lineAddr = address & ~(uint32_t)(memory->getLineSize()-1);
+    if (!entries.empty() && entries.back().lineAddress == lineAddr) {
+        combined++;
+    } else {
+        if ((int)entries.size() == capacity) {
+            return false;
+        }
+        int words = memory->getLineSize()/4;
+        entries.push_back({lineAddr, pc, pc, now, vector<uint32_t>(words, 0), vector<uint32_t>(words, 0)});
+    }
+    StoreBufferEntry *e = &entries.back();
+    int w = (address - lineAddr)/4;
+    e->data[w] = (e->data[w] & ~byte_mask) | (data & byte_mask);
+    e->mask[w] |= byte_mask;
+    e->pc = pc;
+    stores++;
+    return true;
+}
+
+bool StoreBuffer::forward(uint32_t address, uint32_t width, uint32_t &value) {
+    if ((gather(address, value) & width) == width) {
+        DEBUG(*out << "Store buffer: forwarding [" << std::hex << address << std::dec << "]\n");
+        fullForwards++;
+        return true;
+    }
+    return false;
+}
+
+void StoreBuffer::overlay(uint32_t address, uint32_t width, uint32_t &value) {
+    partialForwards += (gather(address, value) & width) != 0;
+}
+
+bool StoreBuffer::drain(bool port_free, bool drain_all) {
+    now++;
+    if (!port_free || entries.empty()) {
+        return false;
+    }
+    StoreBufferEntry &e = entries.front();
+    if (!drain_all && entries.size() == 1 && (int)entries.size() < capacity && now - e.opened < STORE_BUFFER_DRAIN_DELAY) {
+        return false;
+    }
+    if (memory->writeLine(e.lineAddress, e.data, e.mask, core, e.pc)) {
+        DEBUG(*out << "Store buffer: line " << std::hex << e.lineAddress << std::dec << " written\n");
+        entries.pop_front();
+        lineWrites++;
+    }
+    return true;
+}
+
+void StoreBuffer::printStats(ostream &out) {
+    out << "Store buffer: " << stores << " stores (" << combined << " combined into an open line), "
+        << lineWrites << " line writes, " << fullForwards << " loads forwarded, "
+        << partialForwards << " partially\n";
+}
@@ -0,0 +1,90 @@
+#ifndef STOREBUFFER
+#define STOREBUFFER
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include "memory.h"
+
+// Cycles an entry stays open for more stores to combine into it while it is the only one
+#define STORE_BUFFER_DRAIN_DELAY 4
+
+// Retired stores to one L1 line, kept per byte so sb/sh from different stores combine
+struct StoreBufferEntry {
+    uint32_t lineAddress;
+    uint32_t firstPC;                   // oldest store combined into the entry
+    uint32_t pc;                        // youngest store combined into the entry
+    uint64_t opened;                    // cycle the entry was allocated
+    std::vector<uint32_t> data;
+    std::vector<uint32_t> mask;         // bytes of each word that hold store data
+};
+
+// Stores retire into this buffer instead of waiting on the L1, and it drains in the
+// background (oldest entry first, one L1 access per line) whenever MEM leaves the port
+// free. A store only combines into the youngest entry, so entries drain in program order
+// and a line can have several. Loads take their bytes from the buffer when it has them.
+class StoreBuffer {
+    private:
+        std::deque<StoreBufferEntry> entries;   // oldest first
+        int capacity;                           // 0: no store buffer
+        int core;
+        Memory *memory;
+        uint64_t now;
+        uint64_t stores;
+        uint64_t combined;
+        uint64_t lineWrites;
+        uint64_t fullForwards;
+        uint64_t partialForwards;
+        std::ostream *out;                      // debug log
+
+        // Puts the buffered bytes of the word at address into value, younger entries last;
+        // returns the mask of bytes it found
+        uint32_t gather(uint32_t address, uint32_t &value);
+    public:
+        StoreBuffer(Memory *mem, int core_id) {
+            memory = mem;
+            core = core_id;
+            capacity = 0;
+            now = 0;
+            stores = combined = lineWrites = fullForwards = partialForwards = 0;
+            out = &std::cout;
+        }
+        void setCapacity(int num_entries) {
+            capacity = num_entries;
+        }
+        void setOutput(std::ostream *o) {
+            out = o;
+        }
+        bool enabled() {
+            return capacity > 0;
+        }
+        bool empty() {
+            return entries.empty();
+        }
+        // Oldest store still waiting to reach the cache
+        uint32_t oldestPC() {
+            return entries.front().firstPC;
+        }
+
+        // Buffers the bytes of data selected by byte_mask, combining them into the youngest
+        // entry if it holds the same line; returns false if the store needs a new entry and the
+        // buffer is full
+        bool insert(uint32_t address, uint32_t data, uint32_t byte_mask, uint32_t pc);
+
+        // Puts the buffered bytes of the word at address into value. Returns true if they cover
+        // every byte in width, so the load needs nothing from the cache.
+        bool forward(uint32_t address, uint32_t width, uint32_t &value);
+
+        // Same merge for a value a load has finished reading from the cache, for the bytes the
+        // buffer has
+        void overlay(uint32_t address, uint32_t width, uint32_t &value);
+
+        // Called once a cycle. Writes the oldest entry to the L1 if the port is free and the entry
+        // is done combining (a younger one exists, the buffer is full, it waited long enough, or
+        // drain_all). Returns true if it used the port.
+        bool drain(bool port_free, bool drain_all);
+
+        void printStats(std::ostream &out);
+};
+
+#endif
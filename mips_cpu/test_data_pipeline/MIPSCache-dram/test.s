@@ -0,0 +1,18 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $10, $0, 1024
+  sw $10, 0($10)
+  lw $2, 64($10)
+  lw $3, 1024($10)
+  lui $11, 1
+  lw $4, 0($11)
+  lw $5, 128($10)
+  lw $6, 0($10)
+  add $7, $6, $2
+  .end	__start
+  .size	__start, .-__start
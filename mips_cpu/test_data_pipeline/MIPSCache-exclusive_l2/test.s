@@ -0,0 +1,20 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $2, $0, 4
+  addi $10, $0, 1024
+loop:
+  lw $3, 0($10)
+  lw $4, 128($10)
+  lw $5, 64($10)
+  addi $3, $3, 1
+  sw $3, 0($10)
+  addi $2, $2, -1
+  bne $2, $0, loop
+  lw $6, 0($10)
+  .end	__start
+  .size	__start, .-__start
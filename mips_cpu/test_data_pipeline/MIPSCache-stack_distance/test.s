@@ -0,0 +1,22 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $2, $0, 3
+pass:
+  addi $10, $0, 1024
+  addi $11, $0, 1536
+walk:
+  lw $8, 0($10)
+  addi $8, $8, 1
+  sw $8, 0($10)
+  addi $10, $10, 64
+  bne $10, $11, walk
+  addi $2, $2, -1
+  bne $2, $0, pass
+  lw $9, 1024($0)
+  .end	__start
+  .size	__start, .-__start
@@ -0,0 +1,19 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $2, $0, 4
+  addi $10, $0, 1024
+loop:
+  lw $3, 0($10)
+  add $4, $4, $3
+  sw $2, 4($10)
+  addi $10, $10, 4
+  addi $2, $2, -1
+  bne $2, $0, loop
+  lw $5, 1028($0)
+  .end	__start
+  .size	__start, .-__start
@@ -0,0 +1,19 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $10, $0, 1024
+  addi $1, $0, 7
+  sw $1, 0($10)
+  sw $1, 64($10)
+  lw $2, 0($10)
+  addi $3, $2, 1
+  sw $3, 4($10)
+  lw $4, 4($10)
+  lw $5, 64($10)
+  add $6, $4, $5
+  .end	__start
+  .size	__start, .-__start
@@ -0,0 +1,18 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $10, $0, 1024
+  sw $10, 0($10)
+  sw $10, 2048($10)
+  lw $2, 64($10)
+  lui $11, 1
+  sw $2, 0($11)
+  lw $3, 0($10)
+  lw $4, 2048($10)
+  add $5, $3, $4
+  .end	__start
+  .size	__start, .-__start
@@ -0,0 +1,28 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $2, $0, 6
+  addi $10, $0, 1024
+  addi $25, $0, 4
+inc:
+  ll $8, 0($10)
+  addi $8, $8, 1
+  sc $8, 0($10)
+  beq $8, $0, inc
+  addi $2, $2, -1
+  bne $2, $0, inc
+done:
+  ll $8, 4($10)
+  addi $8, $8, 1
+  sc $8, 4($10)
+  beq $8, $0, done
+spin:
+  lw $9, 4($10)
+  bne $9, $25, spin
+  lw $11, 0($10)
+  .end	__start
+  .size	__start, .-__start
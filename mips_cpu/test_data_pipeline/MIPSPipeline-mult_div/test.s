@@ -0,0 +1,44 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $4, $0, -7
+  addi $5, $0, 3
+  mult $4, $5
+  addi $6, $0, 100
+  addi $7, $6, 23
+  mflo $8
+  mfhi $9
+  multu $4, $5
+  mfhi $10
+  div $0, $4, $5
+  addi $11, $7, 1
+  sll $12, $11, 2
+  mflo $13
+  mfhi $14
+  divu $0, $6, $5
+  divu $0, $7, $5
+  mflo $15
+  mfhi $16
+  mthi $6
+  mtlo $7
+  mult $5, $6
+  mfhi $17
+  mflo $18
+  addi $19, $0, 5
+loop:
+  mult $19, $19
+  addi $19, $19, -1
+  mflo $20
+  add $21, $21, $20
+  bne $19, $0, loop
+  sra $22, $4, 1
+  sllv $23, $5, $5
+  srav $24, $4, $5
+  xor $25, $4, $5
+  xori $26, $4, 0xff
+  .end	__start
+  .size	__start, .-__start
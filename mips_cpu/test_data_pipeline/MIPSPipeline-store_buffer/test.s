@@ -0,0 +1,29 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $10, $0, 1024
+  addi $1, $0, 1000
+  addi $3, $0, 255
+  sw $1, 0($10)
+  sh $3, 4($10)
+  lw $2, 0($10)
+  sb $3, 64($10)
+  lw $4, 64($10)
+  lbu $5, 64($10)
+  ll $6, 4($10)
+  addi $6, $6, 1
+  sc $6, 4($10)
+  lw $7, 4($10)
+  add $8, $2, $4
+  lui $11, 1
+  addi $12, $8, 1
+  sw $1, 0($11)
+  sw $3, 128($10)
+  sw $12, 0($11)
+  lw $9, 0($11)
+  .end	__start
+  .size	__start, .-__start
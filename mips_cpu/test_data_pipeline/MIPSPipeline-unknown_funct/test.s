@@ -0,0 +1,12 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $2, $0, 5
+  syscall
+  addi $3, $2, 1
+  .end	__start
+  .size	__start, .-__start
@@ -0,0 +1,29 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $16, $0, 20
+loop:
+  add $4, $16, $0
+  jal outer
+  add $17, $17, $2
+  jal outer
+  sub $17, $17, $4
+  addi $16, $16, -1
+  bne $16, $0, loop
+  j end
+outer:
+  add $18, $31, $0
+  jal leaf
+  add $2, $2, $2
+  jr $18
+leaf:
+  addi $2, $4, 1
+  jr $31
+end:
+  addi $19, $0, 1
+  .end	__start
+  .size	__start, .-__start
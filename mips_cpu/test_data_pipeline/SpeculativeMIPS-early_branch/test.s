@@ -0,0 +1,24 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $2, $0, 4
+  addi $10, $0, 1024
+  sw $2, 0($10)
+loop:
+  addi $3, $3, 1
+  bne $3, $2, skip
+  addi $4, $4, 1
+skip:
+  lw $5, 0($10)
+  beq $5, $0, end
+  addi $6, $6, 1
+  add $7, $7, $6
+  bne $6, $2, loop
+end:
+  addi $8, $0, 1
+  .end	__start
+  .size	__start, .-__start
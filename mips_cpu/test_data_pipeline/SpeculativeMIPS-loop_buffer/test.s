@@ -0,0 +1,24 @@
+  .set noat
+  .text
+  .align	2
+  .globl	__start
+  .ent	__start
+  .type	__start, @function
+__start:
+  addi $2, $0, 3
+outer:
+  addi $3, $0, 6
+first:
+  addi $4, $4, 1
+  addi $3, $3, -1
+  bne $3, $0, first
+  addi $3, $0, 6
+second:
+  addi $5, $5, 2
+  add $6, $6, $4
+  addi $3, $3, -1
+  bne $3, $0, second
+  addi $2, $2, -1
+  bne $2, $0, outer
+  .end	__start
+  .size	__start, .-__start
@@ -0,0 +1,138 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include "trace.h"
+
+using namespace std;
+
+static bool isCompressed(const string &path) {
+    return path.size() > 3 && path.compare(path.size()-3, 3, ".gz") == 0;
+}
+
+// The path as one single-quoted shell word; a quote inside it becomes '\''
+static string shellQuote(const string &path) {
+    string quoted = "'";
+    for (char ch : path) {
+        quoted += (ch == '\'') ? string("'\\''") : string(1, ch);
+    }
+    return quoted + "'";
+}
+
+bool TraceWriter::open(const string &path, int num_cores) {
+    close();
+    piped = isCompressed(path);
+    file = piped ? popen(("gzip -c > " + shellQuote(path)).c_str(), "w") : fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    fwrite(TRACE_MAGIC, 1, 8, file);
+    fputc(num_cores, file);
+    lastPC = 0;
+    lastAddress = 0;
+    return true;
+}
+
+void TraceWriter::putVarint(int64_t delta) {
+    // zigzag, so small negative deltas stay small
+    uint64_t v = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+    while (v >= 0x80) {
+        fputc((int)(v & 0x7f) | 0x80, file);
+        v >>= 7;
+    }
+    fputc((int)v, file);
+}
+
+void TraceWriter::write(const TraceRecord &r) {
+    bool at_pc = (r.address == r.pc);
+    fputc(r.write | (r.instruction << 1) | (at_pc << 2) | (r.core << 3), file);
+    putVarint((int64_t)r.pc - lastPC);
+    lastPC = r.pc;
+    if (!at_pc) {
+        putVarint((int64_t)r.address - lastAddress);
+        lastAddress = r.address;
+    }
+}
+
+void TraceWriter::close() {
+    if (!file) {
+        return;
+    }
+    if (piped) {
+        pclose(file);
+    } else {
+        fclose(file);
+    }
+    file = NULL;
+}
+
+bool TraceReader::open(const string &path) {
+    close();
+    FILE *probe = fopen(path.c_str(), "rb");
+    if (!probe) {
+        return false;
+    }
+    fclose(probe);
+    piped = isCompressed(path);
+    file = piped ? popen(("gzip -dc " + shellQuote(path)).c_str(), "r") : fopen(path.c_str(), "rb");
+    char magic[8];
+    if (!file || fread(magic, 1, 8, file) != 8 || memcmp(magic, TRACE_MAGIC, 8)) {
+        close();
+        return false;
+    }
+    numCores = fgetc(file);
+    lastPC = 0;
+    lastAddress = 0;
+    return numCores > 0;
+}
+
+bool TraceReader::getVarint(int64_t &delta) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) {
+            return false;
+        }
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            delta = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TraceReader::read(TraceRecord &r) {
+    int flags = fgetc(file);
+    int64_t delta;
+    if (flags == EOF || !getVarint(delta)) {
+        return false;
+    }
+    r.write = flags & 1;
+    r.instruction = (flags >> 1) & 1;
+    r.core = flags >> 3;
+    r.pc = lastPC + delta;
+    lastPC = r.pc;
+    if (flags & 4) {
+        r.address = r.pc;
+    } else {
+        if (!getVarint(delta)) {
+            return false;
+        }
+        r.address = lastAddress + delta;
+        lastAddress = r.address;
+    }
+    return true;
+}
+
+void TraceReader::close() {
+    if (!file) {
+        return;
+    }
+    if (piped) {
+        pclose(file);
+    } else {
+        fclose(file);
+    }
+    file = NULL;
+}
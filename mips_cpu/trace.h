@@ -0,0 +1,65 @@
+#ifndef TRACE
+#define TRACE
+#include <cstdio>
+#include <cstdint>
+#include <string>
+
+// Memory-access traces: one record per access the memory system completes
+//
+// File layout: the 8-byte magic "MIPSTRC1", one byte with the number of cores, then records of
+//   flags    1 byte: bit 0 write, bit 1 instruction fetch, bit 2 address == pc, bits 3-7 core
+//   pc       zigzag varint, delta from the previous record's pc
+//   address  zigzag varint, delta from the previous data address (absent when address == pc)
+// so a sequential fetch costs two bytes. Files named *.gz are piped through gzip.
+// Data values are not recorded: traces drive hit/miss and timing, not functional state.
+
+#define TRACE_MAGIC "MIPSTRC1"
+// The core id has 5 bits in the flags byte
+#define TRACE_MAX_CORES 32
+
+struct TraceRecord {
+    uint32_t pc;
+    uint32_t address;
+    bool write;
+    bool instruction;
+    int core;
+};
+
+class TraceWriter {
+    private:
+        FILE *file;
+        bool piped;
+        uint32_t lastPC;
+        uint32_t lastAddress;
+        void putVarint(int64_t delta);
+    public:
+        TraceWriter() { file = NULL; piped = false; }
+        ~TraceWriter() { close(); }
+
+        // Returns false if the file could not be created
+        bool open(const std::string &path, int num_cores);
+        void write(const TraceRecord &r);
+        void close();
+};
+
+class TraceReader {
+    private:
+        FILE *file;
+        bool piped;
+        int numCores;
+        uint32_t lastPC;
+        uint32_t lastAddress;
+        bool getVarint(int64_t &delta);
+    public:
+        TraceReader() { file = NULL; piped = false; numCores = 0; }
+        ~TraceReader() { close(); }
+
+        // Returns false if the file is missing or is not a trace
+        bool open(const std::string &path);
+        // Returns false at the end of the trace
+        bool read(TraceRecord &r);
+        int getNumCores() { return numCores; }
+        void close();
+};
+
+#endif